@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * A tiny benchmark harness in the style of Google Benchmark, so `make bench` needs nothing but the compiler.
+ *
+ *   BENCHMARK(score_board) {
+ *       for(auto _ : state)
+ *           bench::do_not_optimize(score(b));
+ *   }
+ *
+ * Every benchmark is run with 1, 10, 100, ... iterations until one run takes at least the minimum time,
+ * and that run is reported as ns per iteration. A benchmark that calls state.set_items() (e.g. the nodes
+ * a search visited) also gets items per second.
+ */
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from optimizing away a result we never look at.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class State {
+public:
+    explicit State(long iterations) : iterations(iterations) {}
+
+    // What `for(auto _ : state)` binds to. Having a destructor keeps -Wunused-variable quiet about it.
+    struct Iteration {
+        Iteration() {}
+        ~Iteration() {}
+    };
+    struct Iterator {
+        long left;
+        bool operator!=(const Iterator& other) const { return left != other.left; }
+        void operator++() { left--; }
+        Iteration operator*() const { return Iteration(); }
+    };
+    Iterator begin() {
+        start = Clock::now();
+        return Iterator { iterations };
+    }
+    Iterator end() {
+        return Iterator { 0 };
+    }
+
+    long num_iterations() const { return iterations; }
+    // What the benchmark processed over all iterations, reported per second.
+    void set_items(long n, const char* name) {
+        items = n;
+        items_name = name;
+    }
+
+    // Excludes setup done before the loop.
+    Clock::time_point start;
+    long items = -1;
+    const char* items_name = "items";
+private:
+    long iterations;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void(State&)> run;
+};
+
+inline std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+struct Register {
+    Register(const char* name, std::function<void(State&)> run) {
+        registry().push_back(Benchmark { name, run });
+    }
+};
+
+// Runs every benchmark whose name contains filter.
+inline int run_all(const char* filter, double min_seconds) {
+    std::printf("%-40s %12s %16s %20s\n", "benchmark", "iterations", "ns/op", "rate");
+    for(const Benchmark& b : registry()) {
+        if(filter && !std::strstr(b.name.c_str(), filter))
+            continue;
+        for(long n = 1;; n *= 10) {
+            State state(n);
+            b.run(state);
+            double seconds = std::chrono::duration<double>(Clock::now() - state.start).count();
+            if(seconds < min_seconds && n < 1000000000L)
+                continue;
+            char rate[64] = "";
+            if(state.items >= 0)
+                std::snprintf(rate, sizeof(rate), "%.3g %s/s", state.items / seconds, state.items_name);
+            std::printf("%-40s %12ld %16.1f %20s\n", b.name.c_str(), n, seconds * 1e9 / n, rate);
+            std::fflush(stdout);
+            break;
+        }
+    }
+    return 0;
+}
+
+} // namespace bench
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+
+// Defines a benchmark body taking `bench::State& state`.
+#define BENCHMARK(name)                                                                           \
+    static void BENCH_CONCAT(bench_, name)(bench::State& state);                                  \
+    static bench::Register BENCH_CONCAT(register_, name)(#name, BENCH_CONCAT(bench_, name));      \
+    static void BENCH_CONCAT(bench_, name)(bench::State& state)
@@ -0,0 +1,222 @@
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "bench.hpp"
+#include "algorithm.hpp"
+#include "score_batch.hpp"
+
+/**
+ * Microbenchmarks for the hot paths, and end-to-end find_combos, over a fixed corpus of boards.
+ *
+ *   make bench                   # everything
+ *   build/bench score            # only benchmarks whose name contains "score"
+ *   build/bench find_combos 2    # at least 2 seconds per benchmark
+ */
+
+using namespace pad;
+
+namespace {
+
+// The first three are the boards the tests use, the rest are random.
+const std::vector<std::string> CORPUS = {
+    "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR",
+    "HLHBLGGHGRRDRHBGLDDRGRHRLRLRDL",
+    "brbbrrrgrggrglgllgldlddldhdhhd",
+    "LGHDBGHLHBDGHHLBLDHDGBDHBDRHGH",
+    "HLHHGDGLRBHLLRHHGBLBBGBLLBDGLG",
+    "GRHGRBDBDHLDRBHDGGLBGGBLDHGBLD",
+    "BBHHLGHHGBGDHRRGRGLHGBGRGBGHLD",
+    "BLDLHLGRBBBGDHHBDRLGGLGDGBBHRD",
+};
+
+std::vector<Board> corpus_boards() {
+    std::vector<Board> boards;
+    for(const std::string& s : CORPUS)
+        boards.push_back(initialize(s));
+    return boards;
+}
+
+std::vector<BitBoard> corpus_bitboards() {
+    std::vector<BitBoard> boards;
+    for(const Board& b : corpus_boards())
+        boards.push_back(to_bitboard(b));
+    return boards;
+}
+
+// Cycles through the corpus, one board per iteration.
+template <typename F>
+void over_corpus(bench::State& state, F&& f) {
+    auto boards = corpus_boards();
+    std::size_t i = 0;
+    for(auto _ : state) {
+        f(boards[i]);
+        i = i + 1 == boards.size() ? 0 : i + 1;
+    }
+}
+
+// Reported in nodes/s, which unlike boards/s stays comparable when a change prunes more of the tree.
+void find_combos_at(bench::State& state, int depth) {
+    long nodes = 0;
+    over_corpus(state, [&](const Board& b) {
+        dfs::SearchStats stats;
+        dfs::SearchOptions opts;
+        opts.max_depth = depth;
+        opts.stats = &stats;
+        bench::do_not_optimize(dfs::find_combos(b, opts));
+        nodes += stats.nodes;
+    });
+    state.set_items(nodes, "nodes");
+}
+
+} // namespace
+
+BENCHMARK(score_board) {
+    over_corpus(state, [](const Board& b) {
+        Board copy = b;
+        bench::do_not_optimize(score(copy));
+    });
+}
+
+BENCHMARK(score_bitboard) {
+    auto boards = corpus_bitboards();
+    std::size_t i = 0;
+    for(auto _ : state) {
+        BitBoard bb = boards[i];
+        bench::do_not_optimize(score(bb));
+        i = (i + 1) % boards.size();
+    }
+}
+
+BENCHMARK(score_batch_64) {
+    auto corpus = corpus_bitboards();
+    std::vector<BitBoard> boards;
+    for(int i = 0; i < 64; i++)
+        boards.push_back(corpus[i % corpus.size()]);
+    std::vector<int> scores(boards.size());
+    for(auto _ : state) {
+        score_batch(boards.data(), scores.data(), boards.size());
+        bench::do_not_optimize(scores.data());
+    }
+    state.set_items(state.num_iterations() * boards.size(), "boards");
+}
+
+BENCHMARK(remove_match_all_cells) {
+    over_corpus(state, [](const Board& b) {
+        Board copy = b;
+        auto mask = detail::init_mask();
+        for(int i = 0; i < consts::NUM_ROWS; i++) {
+            for(int j = 0; j < consts::NUM_COLS; j++)
+                remove_match(copy, mask, Coord {i, j});
+        }
+        bench::do_not_optimize(mask);
+    });
+}
+
+BENCHMARK(skyfall_board) {
+    // The first wave is cleared up front, so there is something to fall.
+    auto boards = corpus_boards();
+    for(Board& b : boards) {
+        auto mask = detail::init_mask();
+        for(int i = 0; i < consts::NUM_ROWS; i++) {
+            for(int j = 0; j < consts::NUM_COLS; j++)
+                remove_match(b, mask, Coord {i, j});
+        }
+        clear_combos(b, mask);
+    }
+    std::size_t i = 0;
+    for(auto _ : state) {
+        Board copy = boards[i];
+        skyfall(copy);
+        bench::do_not_optimize(copy);
+        i = (i + 1) % boards.size();
+    }
+}
+
+BENCHMARK(skyfall_bitboard) {
+    auto boards = corpus_bitboards();
+    for(BitBoard& bb : boards)
+        clear_matches(bb);
+    std::size_t i = 0;
+    for(auto _ : state) {
+        BitBoard copy = boards[i];
+        skyfall(copy);
+        bench::do_not_optimize(copy);
+        i = (i + 1) % boards.size();
+    }
+}
+
+BENCHMARK(populate) {
+    over_corpus(state, [](const Board& b) {
+        bench::do_not_optimize(populate(b, Coord {2, 2}));
+    });
+}
+
+BENCHMARK(move_board) {
+    over_corpus(state, [](const Board& b) {
+        bench::do_not_optimize(move(b, Coord {2, 2}, Coord {2, 3}));
+    });
+}
+
+BENCHMARK(apply_undo_move) {
+    SearchState s = make_search_state(corpus_boards()[0], {2, 2});
+    for(auto _ : state) {
+        apply_move(s, Action::right);
+        undo_move(s, Action::right);
+        bench::do_not_optimize(s.hash);
+    }
+}
+
+BENCHMARK(max_combos_possible) {
+    over_corpus(state, [](const Board& b) {
+        bench::do_not_optimize(max_combos_possible(b));
+    });
+}
+
+// A single root on the calling thread, to count nodes.
+BENCHMARK(dfs_single_root_10) {
+    long nodes = 0;
+    over_corpus(state, [&](const Board& b) {
+        dfs::SolutionMap map = dfs::empty_solution_map({2, 2});
+        dfs::Incumbent incumbent(max_combos_possible(b));
+        ComboCount policy;
+        dfs::SearchContext<> ctx(max_combos_possible(b), 10, map, policy);
+        ctx.incumbent = &incumbent;
+        auto s = make_search_state(b, {2, 2});
+        Solution sol({2, 2});
+        dfs::dfs(s, ctx, sol, Action::up, 0);
+        nodes += ctx.nodes;
+        bench::do_not_optimize(map);
+    });
+    state.set_items(nodes, "nodes");
+}
+
+BENCHMARK(find_combos_8) {
+    find_combos_at(state, 8);
+}
+
+BENCHMARK(find_combos_10) {
+    find_combos_at(state, 10);
+}
+
+// The same search without a SearchStats, for what counting costs.
+BENCHMARK(find_combos_10_uncounted) {
+    over_corpus(state, [&](const Board& b) {
+        bench::do_not_optimize(dfs::find_combos(b, 10));
+    });
+    state.set_items(state.num_iterations(), "boards");
+}
+
+BENCHMARK(find_combos_12) {
+    find_combos_at(state, 12);
+}
+
+BENCHMARK(find_combos_15) {
+    find_combos_at(state, 15);
+}
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    double min_seconds = argc > 2 ? std::atof(argv[2]) : 0.5;
+    return bench::run_all(filter, min_seconds);
+}
@@ -13,8 +13,10 @@
 
 namespace pad {
 
-Board initialize(const std::string& board_string) {
-    Board b;
+// The string holds Rows * Cols orbs, row by row, e.g. initialize<6, 7>(s) for a 6x7 board.
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+BoardT<Rows, Cols> initialize(const std::string& board_string) {
+    BoardT<Rows, Cols> b;
     // Iterate through board_string
     auto i = 0;
     for(auto& b_ : b) {
@@ -50,35 +52,40 @@ bool opposite_actions(const Action& _a, const Action& _b) noexcept {
 // 0 - no errors
 // 1 - row out of bound
 // 2 - column out of bound
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
 inline int check_move(const Coord& coord) noexcept {
-    if (coord.first < 0 || coord.first >= consts::NUM_ROWS) 
+    if (coord.first < 0 || coord.first >= Dims<Rows, Cols>::NUM_ROWS) 
         return 1;
 
-    if (coord.second < 0 || coord.second >= consts::NUM_COLS) 
+    if (coord.second < 0 || coord.second >= Dims<Rows, Cols>::NUM_COLS) 
         return 2;
 
     return 0;
 }
 
 // Assumption: The new_coord is checked to be valid
-Board move(const Board& board, const Coord& old_coord, const Coord& new_coord) {
+template <std::size_t Rows, std::size_t Cols>
+BoardT<Rows, Cols> move(const BoardT<Rows, Cols>& board, const Coord& old_coord, const Coord& new_coord) {
 #ifdef CHECK_BOUND
-    int check = check_move(new_coord);
+    int check = check_move<Rows, Cols>(new_coord);
     if (check) 
         throw std::logic_error("CHECK_BOUND detected out of bounds coordinate at move().");
 #endif 
-    Board new_board = board;
+    BoardT<Rows, Cols> new_board = board;
     std::swap(new_board[old_coord.first][old_coord.second], new_board[new_coord.first][new_coord.second]);
     return new_board;
 }
 
 // Main driver for populating the next moves.
 // Generates 2-4 moves (2 if it's in a corner, 3 at an edge, 4 elsewhere) in a vector.
-decltype(auto) populate(const Board& board, const Coord& coord) {
-    std::vector<std::pair<Board, Action>> arr;
+// Works for any board representation that has a move() overload (Board, BitBoard).
+template <typename B>
+decltype(auto) populate(const B& board, const Coord& coord) {
+    using D = board_dims<B>;
+    std::vector<std::pair<B, Action>> arr;
     for(const Action& action : consts::ACTIONS) {
         Coord new_coord = change_coords(coord, action);
-        if (check_move(new_coord) == 0) {
+        if (check_move<D::NUM_ROWS, D::NUM_COLS>(new_coord) == 0) {
             arr.emplace_back(move(board, coord, new_coord), action);
         }
     }
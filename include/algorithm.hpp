@@ -9,15 +9,25 @@
 #endif
 
 #include <sstream>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
 #include "thread_pool.hpp"
 #include "action.hpp"
 #include "state.hpp"
 #include "score.hpp"
+#include "search_state.hpp"
+#include "transposition.hpp"
+#include "score_cache.hpp"
+#include "scoring.hpp"
+#include "search_stats.hpp"
 
 namespace pad {
 
 // Retrieves information on how many orbs of each type there are.
-inline std::map<Orb, int> get_freq_orbs(const Board& b) {
+template <std::size_t Rows, std::size_t Cols>
+inline std::map<Orb, int> get_freq_orbs(const BoardT<Rows, Cols>& b) {
     std::map<Orb, int> freq;
     for(const auto& _b : b) {
         for(const auto& o : _b) {
@@ -36,63 +46,115 @@ inline std::map<Orb, int> get_freq_orbs(const Board& b) {
 // Important argument: You cannot have more than MAX_COMBOS/2 of the same color.
 // This is because that means there are less than 3*4 orbs of other colors, and thus
 // consequent combos of the same color will be connected at least once if you have more than
-// 3*6 orbs of the same color.
-int max_combos_possible(const Board& b) {
+// 3*6 orbs of the same color. The same argument holds for the other board sizes.
+template <std::size_t Rows, std::size_t Cols>
+int max_combos_possible(const BoardT<Rows, Cols>& b) {
     int max_combos = 0;
     std::map<Orb, int> freq = get_freq_orbs(b);
     for(const auto& p : freq) {
-        max_combos += std::min(p.second / consts::MIN_ORB_COMBO, consts::MAX_COMBOS / 2); 
+        max_combos += std::min(p.second / consts::MIN_ORB_COMBO, Dims<Rows, Cols>::MAX_COMBOS / 2); 
     }
 
     return max_combos;
 }
 
+/**
+ * A path: the orb it starts from and the moves after that.
+ *
+ * Searches copy the current path into the map every time they improve on a combo count, so it is
+ * a fixed size value that never allocates: every move takes 2 bits (see Action) in one of two words,
+ * which caps a path at MAX_LENGTH moves. The searches never go deeper than that.
+ */
 class Solution {
 public:
-    Solution(Coord coord) : origin(coord), action() {}
+    // The most moves a path can hold: two words of 2 bits per move. Pushing past it throws
+    // std::length_error, and the searches clamp their depth to it (see dfs::clamp_depth).
+    static constexpr int MAX_LENGTH = 64;
+
+    Solution(Coord coord) : row(coord.first), col(coord.second) {}
     int size() const {
-        return action.size();
+        return length;
     }
     Coord get_origin() const {
-        return origin;
+        return Coord {row, col};
     }
     void push_action(const Action& a) {
-        action.push_back(a);
+        if(length >= MAX_LENGTH)
+            throw std::length_error("a Solution holds at most MAX_LENGTH moves");
+        moves[length / 32] |= std::uint64_t(detail::enum_value(a)) << (2 * (length % 32));
+        length++;
     }
     Action pop_action() {
-        Action a = action.back();
-        action.pop_back();
+        length--;
+        Action a = get_action(length);
+        moves[length / 32] &= ~(std::uint64_t(3) << (2 * (length % 32)));
         return a;
     }
+    // The i-th move.
+    Action get_action(int i) const {
+        return Action((moves[i / 32] >> (2 * (i % 32))) & 3);
+    }
     std::string to_string() const {
         std::ostringstream ss;
-        ss << "(" << origin.first << ", " << origin.second << ") : ";
-        for(const Action& a : action) {
-            ss << detail::get_value(consts::ACTION_TO_CHAR, a);
+        ss << "(" << int(row) << ", " << int(col) << ") : ";
+        for(int i = 0; i < length; i++) {
+            ss << detail::get_value(consts::ACTION_TO_CHAR, get_action(i));
         }
         return ss.str();
     }
     std::vector<Action> get_all_action() const {
+        std::vector<Action> action;
+        for(int i = 0; i < length; i++)
+            action.push_back(get_action(i));
         return action;
     }
+    // What the scoring policy made of the board at the end of the path (see scoring.hpp).
+    double get_value() const {
+        return value;
+    }
+    void set_value(double v) {
+        value = v;
+    }
 private:    
-    std::vector<Action> action;
-    Coord origin;
+    // Moves past length are always 0, so pushing only has to OR the new one in.
+    std::uint64_t moves[2] = {0, 0};
+    double value = 0;
+    std::int8_t row;
+    std::int8_t col;
+    std::uint8_t length = 0;
 };
 
+static_assert(std::is_trivially_copyable<Solution>::value, "recording a path should be a plain copy");
+
+// What the board at the end of the path clears, combo by combo.
+template <std::size_t Rows, std::size_t Cols>
+ScoreDetailT<Rows, Cols> explain(const BoardT<Rows, Cols>& b, const Solution& sol) {
+    auto s = make_search_state(b, sol.get_origin());
+    for(int i = 0; i < sol.size(); i++)
+        apply_move(s, sol.get_action(i));
+    ScoreDetailT<Rows, Cols> report;
+    score(s.bits, report);
+    return report;
+}
+
 namespace dfs {
 
 /**
  * Now that we have the mechanics of the game down, and populating next-moves down,
  * the current naive algorithm is just to perform DFS down to some fixed depth, and
- * check the max score.
- *
- * TODO: Implement parallel version
+ * check the max score. The parallel version splits the roots into subtree tasks, see
+ * search_starting_points.
  */
 
 // We restrict the depth to this so it doesn't run forever:
 static const int MAX_DEPTH = 15; // 10 moves max
 
+// What the searches make of a max_depth from the caller: a path holds at most Solution::MAX_LENGTH
+// moves, and a negative depth searches nothing.
+inline int clamp_depth(int max_depth) noexcept {
+    return std::max(0, std::min(max_depth, Solution::MAX_LENGTH));
+}
+
 // We want our solutions to be saved in a simple form: # of combos -> actions
 using SolutionMap = std::vector<Solution>;
 
@@ -100,21 +162,23 @@ using SolutionMap = std::vector<Solution>;
 static const int NUM_TO_POPULATE = 5;
 
 // This distance is the manhattan distance.
-std::vector<std::pair<Coord, int>> distance_from_others(const Board& b) {
+template <std::size_t Rows, std::size_t Cols>
+std::vector<std::pair<Coord, int>> distance_from_others(const BoardT<Rows, Cols>& b) {
+    using D = Dims<Rows, Cols>;
     std::map<Orb, std::vector<Coord>> coord_map;
     std::vector<std::pair<Coord, int>> candidates;
     // Scan to get the coordinates
-    for(int i = 0; i < consts::NUM_ROWS; i++) {
-        for(int j = 0; j < consts::NUM_COLS; j++) {
+    for(int i = 0; i < D::NUM_ROWS; i++) {
+        for(int j = 0; j < D::NUM_COLS; j++) {
             auto o = b[i][j];
             coord_map[o].emplace_back(i, j);
         }
     }
     // Process all candidates. 
-    for(int i = 0; i < consts::NUM_ROWS; i++) {
-        for(int j = 0; j < consts::NUM_COLS; j++) {
+    for(int i = 0; i < D::NUM_ROWS; i++) {
+        for(int j = 0; j < D::NUM_COLS; j++) {
             auto o = b[i][j];
-            int min_dist = consts::NUM_ROWS * consts::NUM_COLS;
+            int min_dist = D::NUM_ORBS;
             for(const auto& c : coord_map[o]){
                 // Same orb doesn't apply.
                 if(c.first == i && c.second == j)
@@ -136,63 +200,402 @@ std::vector<std::pair<Coord, int>> distance_from_others(const Board& b) {
  * 1. Pick orbs that are rly far away from the other orbs
  * 2. Choose orbs that can actually be made into combos
  */
-std::array<Coord, consts::NUM_ORBS> populate_favorable_coords(const Board& b, int num_to_populate) {
-    std::array<Coord, consts::NUM_ORBS> top;
+template <std::size_t Rows, std::size_t Cols>
+std::array<Coord, Dims<Rows, Cols>::NUM_ORBS> populate_favorable_coords(const BoardT<Rows, Cols>& b, int num_to_populate) {
+    std::array<Coord, Dims<Rows, Cols>::NUM_ORBS> top;
     auto freq = get_freq_orbs(b);
     auto candidates = distance_from_others(b);
     std::sort(candidates.begin(), candidates.end(), [] (const auto& a, const auto& b) -> bool {
         return a.second > b.second;
     });
-    for(int i = 0; i < std::min(num_to_populate, consts::NUM_ORBS); i++) {
+    for(int i = 0; i < std::min(num_to_populate, Dims<Rows, Cols>::NUM_ORBS); i++) {
         top[i] = candidates[i].first;
     }
     return top;
 }
 
-// Copy the board down the call
-inline void dfs(const Board& b, const Coord& c, const int max_combos, SolutionMap& map, Solution& cur_sol, const Action& prev_action, int depth, int max_depth) {
-    if(depth > max_depth)
-        return; 
+// How many nodes a DFS visits between two looks at the clock (and the CancelToken). Reading the
+// clock is much more expensive than a node, so we don't do it every time.
+static const long DEADLINE_CHECK_INTERVAL = 1024;
+
+/**
+ * The best (combos, length) found so far by any search, shared between all the workers of one
+ * find_combos call. Both halves are packed in one word so it can be updated with a single
+ * compare-and-swap: more combos is better, then fewer moves.
+ *
+ * It also keeps the shortest length found for every combo count, so a worker doesn't bother
+ * recording a path some other worker already beat, and a subtree can be dropped once every
+ * combo count it could reach already has a path that is no longer than anything in it.
+ */
+class Incumbent {
+public:
+    explicit Incumbent(int max_combos = consts::MAX_COMBOS)
+        : num_counts(max_combos + 1), shortest(new std::atomic<int>[max_combos + 1])
+    {
+        for(int k = 0; k < num_counts; k++)
+            shortest[k].store(NONE, std::memory_order_relaxed);
+    }
+
+    void update(int combos, int length) noexcept {
+        std::uint32_t mine = pack(combos, length);
+        std::uint32_t cur = best.load(std::memory_order_relaxed);
+        while(mine > cur && !best.compare_exchange_weak(cur, mine, std::memory_order_relaxed))
+            ;
+        if(combos < num_counts && lower(shortest[combos], length))
+            update_longest();
+    }
+    int combos() const noexcept {
+        return best.load(std::memory_order_relaxed) >> 16;
+    }
+    int length() const noexcept {
+        return 0xffff - (best.load(std::memory_order_relaxed) & 0xffff);
+    }
+    // The shortest path found for this many combos, or NONE.
+    int shortest_length(int combos) const noexcept {
+        return combos < num_counts ? shortest[combos].load(std::memory_order_relaxed) : NONE;
+    }
+    // Whether a path of this length would be the shortest one for its combo count so far.
+    bool improves(int combos, int length) const noexcept {
+        return length < shortest_length(combos);
+    }
+    // Whether nothing below a node at this depth can do better, given that nothing there makes more than
+    // max_combos: either it cannot reach our combos, or it can at best tie them with a longer path.
+    bool prunes(int max_combos, int depth) const noexcept {
+        std::uint32_t cur = best.load(std::memory_order_relaxed);
+        int combos = cur >> 16;
+        return max_combos < combos || (max_combos == combos && 0xffff - int(cur & 0xffff) <= depth + 1);
+    }
+    // Whether every combo count already has a path no longer than the children of a node at this
+    // depth. Unlike prunes(), nothing below such a node is missed for any combo count.
+    bool covers(int depth) const noexcept {
+        return longest.load(std::memory_order_relaxed) <= depth + 1;
+    }
+
+    static constexpr int NONE = 0xffff;
+
+private:
+    static std::uint32_t pack(int combos, int length) noexcept {
+        return (std::uint32_t(combos) << 16) | std::uint32_t(0xffff - length);
+    }
+    // Lowers a to value if that is lower. Returns whether it did.
+    static bool lower(std::atomic<int>& a, int value) noexcept {
+        int cur = a.load(std::memory_order_relaxed);
+        while(value < cur) {
+            if(a.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+    // The lengths only ever go down, so a racing update can only leave longest too high, never too low.
+    void update_longest() noexcept {
+        int m = 0;
+        for(int k = 0; k < num_counts; k++)
+            m = std::max(m, shortest[k].load(std::memory_order_relaxed));
+        lower(longest, m);
+    }
+
+    std::atomic<std::uint32_t> best {0};
+    const int num_counts;
+    std::unique_ptr<std::atomic<int>[]> shortest;
+    // The longest of the shortest paths, over all combo counts.
+    std::atomic<int> longest {NONE};
+};
+
+/**
+ * Stops a search from another thread, or from within: every DFS looks at it along with the clock,
+ * and workers look at it before picking up their next task, so tasks still sitting in the pool's
+ * queues end right away. Whichever worker notices the deadline first cancels it for the others too.
+ *
+ * With stop_at_max_combos, the first path to reach max_combos_possible() cancels the search, even
+ * though the other workers might still find a shorter one.
+ */
+class CancelToken {
+public:
+    explicit CancelToken(bool stop_at_max_combos = false) noexcept : stop_at_max(stop_at_max_combos) {}
+
+    void cancel() noexcept {
+        flag.store(true, std::memory_order_relaxed);
+    }
+    bool cancelled() const noexcept {
+        return flag.load(std::memory_order_relaxed);
+    }
+    bool stops_at_max_combos() const noexcept {
+        return stop_at_max;
+    }
+private:
+    std::atomic<bool> flag {false};
+    const bool stop_at_max;
+};
+
+// Everything a single DFS needs that stays the same from node to node.
+// Stats is NoStats unless someone asked for a SearchStats, see search_stats.hpp.
+// Only the first four have to be given, the rest is set by name where needed.
+template <typename Policy = ComboCount, typename Stats = NoStats>
+struct SearchContext {
+    SearchContext(int max_combos, int max_depth, SolutionMap& map, const Policy& policy)
+        : max_combos(max_combos), max_depth(max_depth), map(map), policy(policy) {}
+
+    int max_combos;
+    int max_depth;
+    SolutionMap& map;
+    const Policy& policy;
+    // Optional, shared between all the searches of one find_combos call.
+    TranspositionTable* tt = nullptr;
+    // The search gives up (keeping what it found so far) once this passes.
+    Clock::time_point deadline = Clock::time_point::max();
+    long nodes = 0;
+    bool timed_out = false;
+    // Optional, shared between all the workers of one find_combos call.
+    Incumbent* incumbent = nullptr;
+    // Whether to cut subtrees by heuristic_bound(), needs an incumbent.
+    bool bound = false;
+    // Optional, and can outlive the call (see Solver). Only used when Policy::COUNT_ONLY.
+    ScoreCache* cache = nullptr;
+    // Optional, shared between all the workers of one find_combos call (and whoever wants to stop them).
+    CancelToken* cancel = nullptr;
+    // This worker's own counters.
+    Stats stats {};
+};
+
+// Whether the search has to stop now: cancelled, or out of time.
+template <typename Policy, typename Stats>
+inline bool stop_requested(const SearchContext<Policy, Stats>& ctx) noexcept {
+    if(ctx.cancel && ctx.cancel->cancelled())
+        return true;
+    if(Clock::now() >= ctx.deadline) {
+        if(ctx.cancel)
+            ctx.cancel->cancel();
+        return true;
+    }
+    return false;
+}
+
+// Scores the state's board, going through the cache if there is one.
+// A board without a first wave is cheaper to score than to look up.
+// The boards that are simulated go into the cascade histogram, if stats are on.
+template <std::size_t Rows, std::size_t Cols, typename Stats = NoStats>
+inline int cached_score(const SearchStateT<Rows, Cols>& s, ScoreCache* cache, Stats&& stats = Stats()) noexcept {
+    if(!has_matches(s)) {
+        stats.cascade(0);
+        return 0;
+    }
+    int score;
+    if(cache && cache->lookup(s.hash, score))
+        return score;
+    if constexpr(std::decay_t<Stats>::ENABLED) {
+        int waves;
+        score = pad::score(s, waves);
+        stats.cascade(waves);
+    } else {
+        score = pad::score(s);
+    }
+    if(cache)
+        cache->insert(s.hash, score);
+    return score;
+}
+
+// What a node's board is worth.
+struct Evaluation {
+    int combos;
+    double value;
+};
+
+// Scores the state with the context's policy: sets combos and returns the value.
+// Only ComboCount fills the cascade histogram, a weighted policy runs its own simulation.
+template <std::size_t Rows, std::size_t Cols, typename Policy, typename Stats>
+inline double evaluate(const SearchStateT<Rows, Cols>& s, SearchContext<Policy, Stats>& ctx, int& combos) noexcept {
+    ctx.stats.scored();
+    if constexpr(Policy::COUNT_ONLY) {
+        combos = cached_score(s, ctx.cache, ctx.stats);
+        return combos;
+    } else {
+        auto bb = s.bits;
+        return ctx.policy.evaluate(bb, combos);
+    }
+}
+
+// Whether a path of this length and value beats the best one so far for the same combo count:
+// a higher value wins, then a shorter path.
+inline bool improves(const Solution& best, double value, int length) noexcept {
+    return best.size() == 0 || value > best.get_value() || (value == best.get_value() && length < best.size());
+}
+
+// Records the current path if it improves on the best one for its combo count.
+// With lengths only, that includes the ones other workers found.
+template <typename Policy, typename Stats>
+inline void record(SearchContext<Policy, Stats>& ctx, const Solution& cur_sol, int combos, double value) {
+    if(Policy::COUNT_ONLY && ctx.incumbent && !ctx.incumbent->improves(combos, cur_sol.size()))
+        return;
+    if(improves(ctx.map[combos], value, cur_sol.size())) {
+        ctx.map[combos] = cur_sol;
+        ctx.map[combos].set_value(value);
+        if(ctx.incumbent)
+            ctx.incumbent->update(combos, cur_sol.size());
+        if(combos == ctx.max_combos && ctx.cancel && ctx.cancel->stops_at_max_combos())
+            ctx.cancel->cancel();
+    }
+}
+
+// With a weighted policy, a longer path can still be worth more, so only the combo count allows
+// stopping before max_depth, and the incumbent (which only knows about lengths) cannot prune.
+template <typename Policy, typename Stats>
+inline bool done(const SearchContext<Policy, Stats>& ctx, int combos, int depth) noexcept {
+    return (Policy::COUNT_ONLY && combos == ctx.max_combos) || depth >= ctx.max_depth;
+}
+
+/**
+ * Heuristic branch and bound: besides stopping once max_combos is reached, an interior node is cut
+ * when heuristic_bound() says nothing below it can beat the best (combos, length) found so far, see
+ * Incumbent. The bound is a guess, not an upper bound, so this can cut the best path too.
+ *
+ * Moves only shuffle orbs between the cells the cursor can still walk over, so with k moves left every
+ * orb outside the k-step diamond around the cursor stays put and the orbs inside it stay inside it.
+ * That bounds the first wave of every board below: runs of fixed orbs can only make the combos they
+ * already make, and every other combo needs one of the color's orbs in the diamond plus at least
+ * MIN_ORB_COMBO orbs in total.
+ *
+ * Cascades are the catch. Any first wave can in principle set off a cascade of up to max_combos, so a
+ * bound that holds for every board is no better than max_combos_possible(). We allow for
+ * CASCADE_ALLOWANCE extra combos instead, which keeps the best combos found on our test boards while
+ * searching a fraction of the nodes. That makes it a heuristic: whenever a cascade adds more than the
+ * allowance, the best path can be cut and the result is suboptimal. It is opt-in for that reason, and
+ * because lower combo counts lose their shortest paths.
+ */
+
+// How many combos cascades are assumed to add on top of the first wave.
+static const int CASCADE_ALLOWANCE = 2;
+
+// Every cell the cursor can walk over with moves_left more moves.
+template <std::size_t Rows, std::size_t Cols>
+inline MaskT<Rows, Cols> reachable_cells(const Coord& cursor, int moves_left) noexcept {
+    using L = Layout<Rows, Cols>;
+    if(moves_left >= L::NUM_ROWS + L::NUM_COLS - 2)
+        return L::BOARD_MASK;
+    auto reach = L::cell_bit(cursor);
+    for(int k = 0; k < moves_left; k++)
+        reach |= pad::detail::neighbors<Rows, Cols>(reach);
+    return reach;
+}
+
+// An upper bound on the first wave of every board the remaining moves can reach from s.
+// This part is admissible, it is the allowance for cascades in heuristic_bound() that is a guess.
+template <std::size_t Rows, std::size_t Cols>
+inline int first_wave_bound(const SearchStateT<Rows, Cols>& s, int moves_left) noexcept {
+    using pad::detail::popcount;
+    auto reach = reachable_cells<Rows, Cols>(s.cursor, moves_left);
+    // Fixed cells that a run through the reachable cells can still use.
+    auto near = pad::detail::neighbors<Rows, Cols>(reach);
+    near |= pad::detail::neighbors<Rows, Cols>(near);
+    int bound = 0;
+    for(int k = 0; k < consts::NUM_PLANES; k++) {
+        if(Orb(k) == Orb::empty)
+            continue;
+        auto plane = s.bits.planes[k];
+        auto fixed = plane & ~reach;
+        int movable = popcount(plane & reach);
+        int combos = pad::detail::count_components<Rows, Cols>(pad::detail::match_mask<Rows, Cols>(fixed));
+        if(movable && pad::detail::match_mask<Rows, Cols>(fixed | reach))
+            combos += std::min(movable, (movable + popcount(fixed & near & ~reach)) / consts::MIN_ORB_COMBO);
+        bound += std::min(combos, popcount(plane) / consts::MIN_ORB_COMBO);
+    }
+    return bound;
+}
+
+// The first wave bound plus CASCADE_ALLOWANCE. Not an upper bound on the combos after cascades,
+// see above. Without a first wave there are no cascades either, so that case is exact.
+template <std::size_t Rows, std::size_t Cols>
+inline int heuristic_bound(const SearchStateT<Rows, Cols>& s, int moves_left, int max_combos) noexcept {
+    int first_wave = first_wave_bound(s, moves_left);
+    return first_wave ? std::min(max_combos, first_wave + CASCADE_ALLOWANCE) : 0;
+}
+
+// The board is modified in place on the way down and restored on the way back up.
+// When the last move swapped two orbs of the same color, the board is the parent's, and so is
+// its evaluation, which the parent passes down as same_board.
+template <std::size_t Rows, std::size_t Cols, typename Policy, typename Stats>
+inline void dfs(SearchStateT<Rows, Cols>& s, SearchContext<Policy, Stats>& ctx, Solution& cur_sol, const Action& prev_action, int depth,
+                const Evaluation* same_board = nullptr) {
+    if(ctx.timed_out)
+        return;
+    if(++ctx.nodes % DEADLINE_CHECK_INTERVAL == 0 && stop_requested(ctx)) {
+        ctx.timed_out = true;
+        return;
+    }
 
     int cur_score = 0;
+    Evaluation here {0, 0};
     // A depth of 0 should not be able to update any solutions.
     if(depth) {
-        Board board_copy(b);
-        cur_score = pad::score(board_copy);
-        // We found a solution with lower size
-        if(map[cur_score].size() == 0 || cur_sol.size() < map[cur_score].size()) {
-            map[cur_score] = cur_sol;
-        }
+        // We already searched this exact state with at least as many moves left.
+        // Leaves are cheaper to score than to look up, so only interior nodes go through the table.
+        if(ctx.tt && depth < ctx.max_depth && ctx.tt->probe(state_key(s), depth))
+            return;
+        if(same_board)
+            here = *same_board;
+        else
+            here.value = evaluate(s, ctx, here.combos);
+        cur_score = here.combos;
+        // We found a better (or equally good but shorter) solution
+        record(ctx, cur_sol, cur_score, here.value);
     }
 
     // We cannot get any higher than MAX_COMBOS, so no point in DFS'ing further.
-    if(cur_score == max_combos)
+    if(done(ctx, cur_score, depth))
         return;
+    if constexpr(Policy::COUNT_ONLY) {
+        // Someone else already has a max_combos path no longer than our children would be,
+        // or has a path for every combo count that is.
+        if(ctx.incumbent && (ctx.incumbent->prunes(ctx.max_combos, depth) || ctx.incumbent->covers(depth)))
+            return;
+        // Nothing below can beat what someone already found.
+        if(ctx.bound && ctx.incumbent && ctx.incumbent->prunes(heuristic_bound(s, ctx.max_depth - depth, ctx.max_combos), depth))
+            return;
+    }
 
-    auto next_boards = populate(b, c);
-    for(const auto& p : next_boards) {
-        const Board& next_b = p.first; 
-        const Action& next_a = p.second;
+    for(const Action& next_a : consts::ACTIONS) {
         // if action taken is the opposite as the one previously, we know it's suboptimal, so prune it.
         // this pesky removal turns this into a 3^k problem instead of 4^k.
-        if(depth != 0 && opposite_actions(prev_action, next_a))
+        if(depth != 0 && opposite_actions(prev_action, next_a)) {
+            ctx.stats.pruned_opposite();
             continue; // skip this one.
+        }
+        if(check_move<Rows, Cols>(change_coords(s.cursor, next_a)) != 0)
+            continue;
 
-        // We are changing the "cur_sol" and then flipping it back here:
+        // We are changing the "cur_sol" and the board and then flipping them back here:
+        Coord next = change_coords(s.cursor, next_a);
+        bool same = depth && s.board[s.cursor.first][s.cursor.second] == s.board[next.first][next.second];
         cur_sol.push_action(next_a);
-        dfs(next_b, change_coords(c, next_a), max_combos, map, cur_sol, next_a, depth+1, max_depth); 
+        apply_move(s, next_a);
+        dfs(s, ctx, cur_sol, next_a, depth+1, same ? &here : nullptr);
+        undo_move(s, next_a);
         cur_sol.pop_action();
     }
 }
 
-inline void dfs_find(const Board& b, const Coord& c, const int max_combos, SolutionMap& map, int max_depth) {
+// Returns false if the deadline passed (or the search was cancelled) before it was done, in which
+// case map only holds what was found until then.
+template <std::size_t Rows, std::size_t Cols, typename Policy = ComboCount>
+inline bool dfs_find(const BoardT<Rows, Cols>& b, const Coord& c, const int max_combos, SolutionMap& map, int max_depth,
+                     TranspositionTable* tt = nullptr, Clock::time_point deadline = Clock::time_point::max(),
+                     CancelToken* cancel = nullptr, const Policy& policy = Policy()) {
+    if(Clock::now() >= deadline || (cancel && cancel->cancelled()))
+        return false;
+    max_depth = clamp_depth(max_depth);
     Solution s(c); 
+    auto state = make_search_state(b, c);
+    SearchContext<Policy> ctx(max_combos, max_depth, map, policy);
+    ctx.tt = tt;
+    ctx.deadline = deadline;
+    ctx.cancel = cancel;
     // Action::up here is just a stub.
-    dfs(b, c, max_combos, map, s, Action::up, 0, max_depth);
+    dfs(state, ctx, s, Action::up, 0);
+    return !ctx.timed_out;
 }
 
 // IMPORTANT: We don't care about num_to_populate if it's not smart.
-inline std::vector<Coord> get_starting_points(const Board& b, bool smart_populate, int num_to_populate) {
+template <std::size_t Rows, std::size_t Cols>
+inline std::vector<Coord> get_starting_points(const BoardT<Rows, Cols>& b, bool smart_populate, int num_to_populate) {
     std::vector<Coord> starting_points;
     if(smart_populate) { 
         auto coords = populate_favorable_coords(b, num_to_populate);
@@ -202,8 +605,8 @@ inline std::vector<Coord> get_starting_points(const Board& b, bool smart_populat
         }
     }
     else {
-        for(int i = 0; i < consts::NUM_ROWS; i++) {
-            for(int j = 0; j < consts::NUM_COLS; j++) {
+        for(int i = 0; i < int(Rows); i++) {
+            for(int j = 0; j < int(Cols); j++) {
                 starting_points.emplace_back(i, j);
             }
         }
@@ -211,63 +614,353 @@ inline std::vector<Coord> get_starting_points(const Board& b, bool smart_populat
     return starting_points;
 }
 
-// IMPORTANT: We don't care about num_to_populate if it's not smart.
-SolutionMap find_combos(const Board& b, int max_depth = MAX_DEPTH, bool smart_populate = false, int num_to_populate = NUM_TO_POPULATE) {
-    int max_combos = max_combos_possible(b);
+// Fill the map with MAX_COMBOS entries all with origins at c
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+inline SolutionMap empty_solution_map(const Coord& c) {
+    SolutionMap map;
+    for(int k = 0; k < Dims<Rows, Cols>::MAX_COMBOS + 1; k++) {
+        map.emplace_back(c);
+    }
+    return map;
+}
+
+// Keeps the better solution for every combo count, see improves().
+inline void merge_solutions(SolutionMap& aggregate, const SolutionMap& map) {
+    for(size_t k = 0; k < map.size(); k++) {
+        // Invalid move, 0 moves is not allowed.
+        if(!map[k].size())
+            continue;
+        if(improves(aggregate[k], map[k].get_value(), map[k].size()))
+            aggregate[k] = map[k];
+    }
+}
+
+/**
+ * Running one thread per starting point balances badly: some roots are much more expensive
+ * than others, and 30 threads either oversubscribe small machines or leave big ones idle.
+ * Instead, every root is unrolled down to split_depth moves, and each node at that depth
+ * becomes a subtree task. One worker per hardware thread then keeps grabbing the next task
+ * until there are none left, so the load evens out as long as there are many more tasks
+ * than workers.
+ */
+
+// Let search_starting_points pick the split depth.
+static const int AUTO_SPLIT_DEPTH = 0;
 
-    SolutionMap aggregate;
-    for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
-        aggregate.emplace_back(Coord {0, 0});
+// How find_combos and find_combos_until search, besides the board itself. Anything not set keeps
+// the default below, e.g.
+//
+//   SearchOptions opts;
+//   opts.max_depth = 12;
+//   opts.cancel = &token;
+//   find_combos(b, opts);
+struct SearchOptions {
+    int max_depth = MAX_DEPTH;
+    bool smart_populate = false;
+    // IMPORTANT: We don't care about num_to_populate if it's not smart.
+    int num_to_populate = NUM_TO_POPULATE;
+    // How deep the roots are unrolled into tasks for the workers. find_combos_until always picks its own.
+    int split_depth = AUTO_SPLIT_DEPTH;
+    // Without a pool, one is made for the call only (see Solver for one that outlives the call).
+    ThreadPool* pool = nullptr;
+    // Also cut subtrees by heuristic_bound(), see above.
+    bool bound = false;
+    // Boards scored by an earlier call (or another thread) are not scored again.
+    ScoreCache* cache = nullptr;
+    // Cancelling the token stops the search, keeping what it found so far.
+    CancelToken* cancel = nullptr;
+    // Gets what the search did added to it (see search_stats.hpp). Without, it isn't even counted.
+    SearchStats* stats = nullptr;
+    // One that outlives the call (see Solver) saves allocating and clearing a new one.
+    TranspositionTable* tt = nullptr;
+};
+
+// We want at least this many subtree tasks per worker for the load to even out.
+static const int TASKS_PER_WORKER = 16;
+
+template <std::size_t Rows, std::size_t Cols>
+struct SubtreeTask {
+    SearchStateT<Rows, Cols> state;
+    Solution sol;
+    Action prev_action;
+    int depth;
+    // The index of the starting point it came from.
+    int root;
+};
+
+// The smallest depth at which the roots unroll into enough tasks to keep every worker busy.
+inline int choose_split_depth(int num_roots, int num_workers, int max_depth) {
+    int depth = 1;
+    // Roughly 3 children per node, see dfs.
+    long tasks = 3L * num_roots;
+    while(tasks < long(TASKS_PER_WORKER) * num_workers && depth < max_depth) {
+        tasks *= 3;
+        depth++;
+    }
+    return depth;
+}
+
+// Same as dfs, except that instead of recursing past split_depth it hands the node off as a task.
+template <std::size_t Rows, std::size_t Cols, typename Policy, typename Stats>
+inline void split(SearchStateT<Rows, Cols>& s, SearchContext<Policy, Stats>& ctx, Solution& cur_sol, const Action& prev_action, int depth,
+                  int split_depth, int root, std::vector<SubtreeTask<Rows, Cols>>& tasks) {
+    if(depth == split_depth) {
+        tasks.push_back(SubtreeTask<Rows, Cols> { s, cur_sol, prev_action, depth, root });
+        return;
     }
+    ctx.nodes++;
+    int cur_score = 0;
+    if(depth) {
+        double value = evaluate(s, ctx, cur_score);
+        record(ctx, cur_sol, cur_score, value);
+    }
+    if(done(ctx, cur_score, depth))
+        return;
 
-    std::vector<Coord> starting_points = get_starting_points(b, smart_populate, num_to_populate);
+    for(const Action& next_a : consts::ACTIONS) {
+        if(depth != 0 && opposite_actions(prev_action, next_a)) {
+            ctx.stats.pruned_opposite();
+            continue;
+        }
+        if(check_move<Rows, Cols>(change_coords(s.cursor, next_a)) != 0)
+            continue;
+        cur_sol.push_action(next_a);
+        apply_move(s, next_a);
+        split(s, ctx, cur_sol, next_a, depth+1, split_depth, root, tasks);
+        undo_move(s, next_a);
+        cur_sol.pop_action();
+    }
+}
 
+// What one worker of search_subtrees() hands back.
+template <typename Stats>
+struct WorkerResult {
+    SolutionMap map;
+    bool complete;
+    Stats stats;
+    long nodes;
+    Clock::time_point start;
+    Clock::time_point finish;
+};
+
+// search_starting_points() for one kind of Stats, which it adds to stats (if that's on).
+template <typename Stats, std::size_t Rows, std::size_t Cols, typename Policy>
+inline bool search_subtrees(const BoardT<Rows, Cols>& b, const std::vector<Coord>& starting_points, int max_combos,
+                            TranspositionTable& tt, Clock::time_point deadline, SolutionMap& aggregate,
+                            const SearchOptions& opts, const Policy& policy) {
+    auto search_start = Clock::now();
+    int split_depth = opts.split_depth;
+    ThreadPool* pool = opts.pool;
+    CancelToken* cancel = opts.cancel;
+    SearchStats* stats = opts.stats;
+    // The workers need a token to tell each other about the deadline.
+    CancelToken own_token;
+    if(!cancel)
+        cancel = &own_token;
+    if(search_start >= deadline || cancel->cancelled())
+        return false;
+    int max_depth = clamp_depth(opts.max_depth);
+
+    // The calling thread is a worker too.
 #ifdef MULTITHREAD
-    std::vector<std::future<SolutionMap>> results;
-    int num_pts = starting_points.size();
-    results.reserve(num_pts);
-    ThreadPool pool(num_pts);
-    for(const Coord& c : starting_points) {
-        results.push_back( pool.enqueue( [](const Board& b, const Coord& c, int max_combos, int max_depth) {
-                SolutionMap map;
-                // Fill the map with MAX_COMBOS entries all with origins at i,j
-                for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
-                    map.emplace_back(c);
-                }
-                dfs_find(b, c, max_combos, map, max_depth);
-                return map;
-            }, b, c, max_combos, max_depth)
-        );
+    int num_workers = pool ? pool->size() + 1 : std::max(1u, std::thread::hardware_concurrency());
+#else
+    int num_workers = 1;
+#endif
+    if(split_depth == AUTO_SPLIT_DEPTH)
+        split_depth = choose_split_depth(starting_points.size(), num_workers, max_depth);
+
+    Incumbent incumbent(max_combos);
+    std::vector<SubtreeTask<Rows, Cols>> tasks;
+    // The nodes above split_depth are few, so they are scored right here.
+    SolutionMap top_map = empty_solution_map<Rows, Cols>({0, 0});
+    // Every context of this call shares the same tables, deadline and token.
+    auto context = [&](SolutionMap& map) {
+        SearchContext<Policy, Stats> ctx(max_combos, max_depth, map, policy);
+        ctx.tt = &tt;
+        ctx.deadline = deadline;
+        ctx.incumbent = &incumbent;
+        ctx.bound = opts.bound;
+        ctx.cache = opts.cache;
+        ctx.cancel = cancel;
+        return ctx;
+    };
+    auto top = context(top_map);
+    for(size_t r = 0; r < starting_points.size(); r++) {
+        const Coord& c = starting_points[r];
+        auto root_start = Clock::now();
+        Solution s(c);
+        auto state = make_search_state(b, c);
+        // Action::up here is just a stub.
+        split(state, top, s, Action::up, 0, split_depth, r, tasks);
+        if constexpr(Stats::ENABLED)
+            top.stats.add_root_time(r, Clock::now() - root_start);
     }
-    for(auto& f : results) {
-        auto map = f.get();
-        for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
-            // Invalid move, 0 moves is not allowed.
-            if(!map[k].size())
-                continue;
-            if(map[k].size() < aggregate[k].size() || aggregate[k].size() == 0)
-                aggregate[k] = map[k];
+    merge_solutions(aggregate, top_map);
+
+    std::atomic<size_t> next_task {0};
+    auto worker = [&]() {
+        WorkerResult<Stats> res { empty_solution_map<Rows, Cols>({0, 0}), true, Stats(), 0, Clock::now(), {} };
+        auto ctx = context(res.map);
+        // A worker that only starts once the search was cancelled has nothing left to do.
+        for(size_t i = next_task++; i < tasks.size() && !ctx.timed_out && !cancel->cancelled(); i = next_task++) {
+            auto& t = tasks[i];
+            auto task_start = Stats::ENABLED ? Clock::now() : Clock::time_point();
+            dfs(t.state, ctx, t.sol, t.prev_action, t.depth);
+            if constexpr(Stats::ENABLED)
+                ctx.stats.add_root_time(t.root, Clock::now() - task_start);
         }
+        res.complete = !ctx.timed_out;
+        res.stats = ctx.stats;
+        res.nodes = ctx.nodes;
+        res.finish = Clock::now();
+        return res;
+    };
+
+    std::vector<WorkerResult<Stats>> done;
+#ifdef MULTITHREAD
+    int num_helpers = std::min<int>(num_workers, tasks.size()) - 1;
+    std::unique_ptr<ThreadPool> own_pool;
+    if(!pool && num_helpers > 0) {
+        own_pool.reset(new ThreadPool(num_helpers));
+        pool = own_pool.get();
+    }
+    std::vector<std::future<WorkerResult<Stats>>> results;
+    auto enqueued = Clock::now();
+    for(int i = 0; i < num_helpers; i++) {
+        results.push_back(pool->enqueue(worker));
+    }
+    done.push_back(worker());
+    for(auto& f : results) {
+        done.push_back(f.get());
     }
 #else
-    for(const Coord& c : starting_points) {
-        SolutionMap map;
-        // Fill the map with MAX_COMBOS entries all with origins at i,j
-        for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
-            map.emplace_back(c);
+    auto enqueued = Clock::now();
+    done.push_back(worker());
+#endif
+    bool complete = true;
+    for(const auto& res : done) {
+        merge_solutions(aggregate, res.map);
+        complete &= res.complete;
+    }
+
+    if constexpr(Stats::ENABLED) {
+        auto search_end = Clock::now();
+        if(stats->thread_nodes.size() < done.size()) {
+            stats->thread_nodes.resize(done.size(), 0);
+            stats->thread_idle.resize(done.size(), Clock::duration(0));
         }
-        dfs_find(b, c, max_combos, map, max_depth);
-        for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
-            // Invalid move, 0 moves is not allowed.
-            if(!map[k].size())
-                continue;
-            if(map[k].size() < aggregate[k].size() || aggregate[k].size() == 0)
-                aggregate[k] = map[k];
+        if(stats->roots.empty())
+            stats->roots = starting_points;
+        top.stats.merge_into(*stats);
+        stats->nodes += top.nodes;
+        stats->thread_nodes[0] += top.nodes;
+        for(size_t i = 0; i < done.size(); i++) {
+            done[i].stats.merge_into(*stats);
+            stats->nodes += done[i].nodes;
+            stats->thread_nodes[i] += done[i].nodes;
+            stats->thread_idle[i] += (done[i].start - enqueued) + (search_end - done[i].finish);
         }
+        stats->wall += search_end - search_start;
     }
-#endif
+    return complete && !cancel->cancelled();
+}
+
+// Runs a fixed depth search (opts.max_depth) from every starting point and merges the results.
+// Returns false if the deadline (or opts.cancel) cut any of the searches short.
+// Which starting points and which transposition table are up to the caller, so opts.smart_populate,
+// opts.num_to_populate and opts.tt are not looked at.
+template <std::size_t Rows, std::size_t Cols, typename Policy = ComboCount>
+inline bool search_starting_points(const BoardT<Rows, Cols>& b, const std::vector<Coord>& starting_points, int max_combos,
+                                   TranspositionTable& tt, Clock::time_point deadline, SolutionMap& aggregate,
+                                   const SearchOptions& opts = SearchOptions(), const Policy& policy = Policy()) {
+    if(opts.stats)
+        return search_subtrees<ThreadStats>(b, starting_points, max_combos, tt, deadline, aggregate, opts, policy);
+    return search_subtrees<NoStats>(b, starting_points, max_combos, tt, deadline, aggregate, opts, policy);
+}
+
+// Once some path reaches max_combos_possible(), nodes that can only lead to longer paths are no longer
+// searched, so the lower combo counts only report the shortest path found up to that point.
+// With opts.bound, the same goes for any node that heuristic_bound() says cannot beat the best path so far.
+// With a weighted policy (see scoring.hpp), every combo count keeps its highest value path instead, and
+// the search always goes down to max_depth.
+// See SearchOptions for the rest.
+template <std::size_t Rows, std::size_t Cols, typename Policy = ComboCount>
+SolutionMap find_combos(const BoardT<Rows, Cols>& b, const SearchOptions& opts, const Policy& policy = Policy()) {
+    int max_combos = max_combos_possible(b);
+    SolutionMap aggregate = empty_solution_map<Rows, Cols>({0, 0});
+    std::vector<Coord> starting_points = get_starting_points(b, opts.smart_populate, opts.num_to_populate);
+
+    // States are shared across starting points too: a state reached from another origin with a
+    // path that is no longer gives the same solution lengths.
+    TranspositionTable* tt = opts.tt;
+    std::unique_ptr<TranspositionTable> own_tt;
+    if(tt) {
+        tt->new_search();
+    } else {
+        own_tt.reset(new TranspositionTable());
+        tt = own_tt.get();
+    }
+    search_starting_points(b, starting_points, max_combos, *tt, Clock::time_point::max(), aggregate, opts, policy);
     return aggregate;
 }
 
+// IMPORTANT: We don't care about num_to_populate if it's not smart.
+template <std::size_t Rows, std::size_t Cols>
+SolutionMap find_combos(const BoardT<Rows, Cols>& b, int max_depth = MAX_DEPTH, bool smart_populate = false, int num_to_populate = NUM_TO_POPULATE) {
+    SearchOptions opts;
+    opts.max_depth = max_depth;
+    opts.smart_populate = smart_populate;
+    opts.num_to_populate = num_to_populate;
+    return find_combos(b, opts);
+}
+
+/**
+ * Iterative deepening: search depth 1, 2, 3, ... and keep the merged results as we go,
+ * so there is always an answer when the deadline hits. Searching every shallower depth first
+ * costs about half of the last one on top, since each level has ~3x the nodes of the previous.
+ *
+ * Stops at the deadline (the interrupted depth still contributes what it found), at opts.max_depth,
+ * or as soon as a max_combos_possible() solution is found, since deeper ones can only be longer
+ * (only for ComboCount: with a weighted policy a longer one can be worth more).
+ *
+ * With opts.stats, every depth adds to it. The rest of opts works the same as for find_combos.
+ */
+template <std::size_t Rows, std::size_t Cols, typename Policy = ComboCount>
+SolutionMap find_combos_until(const BoardT<Rows, Cols>& b, Clock::time_point deadline, const SearchOptions& opts,
+                              const Policy& policy = Policy()) {
+    int max_combos = max_combos_possible(b);
+    int max_depth = clamp_depth(opts.max_depth);
+    SolutionMap aggregate = empty_solution_map<Rows, Cols>({0, 0});
+    std::vector<Coord> starting_points = get_starting_points(b, opts.smart_populate, opts.num_to_populate);
+
+    TranspositionTable* tt = opts.tt;
+    std::unique_ptr<TranspositionTable> own_tt;
+    if(!tt) {
+        own_tt.reset(new TranspositionTable());
+        tt = own_tt.get();
+    }
+    SearchOptions level = opts;
+    level.split_depth = AUTO_SPLIT_DEPTH;
+    for(int depth = 1; depth <= max_depth; depth++) {
+        tt->new_search();
+        level.max_depth = depth;
+        bool complete = search_starting_points(b, starting_points, max_combos, *tt, deadline, aggregate, level, policy);
+        if(!complete || (Policy::COUNT_ONLY && aggregate[max_combos].size() != 0))
+            break;
+    }
+    return aggregate;
+}
+
+template <std::size_t Rows, std::size_t Cols>
+SolutionMap find_combos_until(const BoardT<Rows, Cols>& b, Clock::time_point deadline, int max_depth = MAX_DEPTH,
+                              bool smart_populate = false, int num_to_populate = NUM_TO_POPULATE) {
+    SearchOptions opts;
+    opts.max_depth = max_depth;
+    opts.smart_populate = smart_populate;
+    opts.num_to_populate = num_to_populate;
+    return find_combos_until(b, deadline, opts);
+}
+
 } // namespace dfs
 } // namespace pad
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "thread_pool.hpp"
+#include "action.hpp"
+#include "state.hpp"
+#include "score.hpp"
+#include "score_batch.hpp"
+#include "search_state.hpp"
+#include "algorithm.hpp"
+
+namespace pad {
+namespace beam {
+
+/**
+ * The DFS is exhaustive, so it can't go much deeper than 15 moves. Real boards want 25-40 move
+ * paths, so instead we keep only the best beam_width partial paths at every depth and only
+ * expand those. This is not guaranteed to find the optimum, but it finds very good paths
+ * far deeper than DFS ever can.
+ *
+ * Paths are ranked by their score first, and then by how many same-colored orbs are next to each
+ * other, since boards with more adjacent pairs are closer to making more combos.
+ */
+
+using dfs::SolutionMap;
+
+static const int MAX_DEPTH = 30;
+
+// How many partial paths we keep at every depth.
+static const int BEAM_WIDTH = 5000;
+
+// Past this many paths per thread it is worth expanding a depth in parallel.
+static const int MIN_PARALLEL_CHUNK = 256;
+
+namespace detail {
+// Number of orthogonally adjacent pairs of orbs with the same color.
+template <std::size_t Rows, std::size_t Cols>
+inline int adjacent_pairs(const BitBoardT<Rows, Cols>& bb) noexcept {
+    using L = Layout<Rows, Cols>;
+    int pairs = 0;
+    for(int k = 0; k < consts::NUM_PLANES; k++) {
+        if(Orb(k) == Orb::empty)
+            continue;
+        auto p = bb.planes[k];
+        pairs += pad::detail::popcount(p & (p >> 1) & ~L::BOTTOM_ROW);
+        pairs += pad::detail::popcount(p & (p >> L::NUM_ROWS));
+    }
+    return pairs;
+}
+
+template <std::size_t Rows, std::size_t Cols>
+struct Node {
+    SearchStateT<Rows, Cols> state;
+    Solution sol;
+    Action prev_action;
+    int score;
+    // Higher is better, see rank().
+    int rank;
+};
+
+template <std::size_t Rows, std::size_t Cols>
+inline int rank(int score, const BitBoardT<Rows, Cols>& bb) noexcept {
+    // There are fewer adjacent pairs than twice the cells on the board, so the score always dominates.
+    return score * (2 * Dims<Rows, Cols>::NUM_ORBS) + adjacent_pairs(bb);
+}
+
+// Expands every node in [first, last) by one move.
+// The children come in big groups, so they are scored together with score_batch().
+template <std::size_t Rows, std::size_t Cols>
+inline void expand(const std::vector<Node<Rows, Cols>>& beam, size_t first, size_t last, std::vector<Node<Rows, Cols>>& children) {
+    size_t first_child = children.size();
+    for(size_t i = first; i < last; i++) {
+        const auto& n = beam[i];
+        for(const Action& a : consts::ACTIONS) {
+            // Going back the way we came is never useful.
+            if(n.sol.size() != 0 && opposite_actions(n.prev_action, a))
+                continue;
+            if(check_move<Rows, Cols>(change_coords(n.state.cursor, a)) != 0)
+                continue;
+            children.push_back(n);
+            auto& child = children.back();
+            apply_move(child.state, a);
+            child.sol.push_action(a);
+            child.prev_action = a;
+        }
+    }
+    std::vector<BitBoardT<Rows, Cols>> bits;
+    bits.reserve(children.size() - first_child);
+    for(size_t i = first_child; i < children.size(); i++)
+        bits.push_back(children[i].state.bits);
+    std::vector<int> scores(bits.size());
+    score_batch(bits.data(), scores.data(), bits.size());
+    for(size_t i = first_child; i < children.size(); i++) {
+        auto& child = children[i];
+        child.score = scores[i - first_child];
+        child.rank = rank(child.score, child.state.bits);
+    }
+}
+} // namespace detail
+
+// IMPORTANT: We don't care about num_to_populate if it's not smart.
+// Without a pool, one is made for this call only (see Solver for one that outlives the call).
+// The deadline is checked before every depth, so the search keeps what the depths before it found,
+// and can run past it by as long as one depth takes.
+template <std::size_t Rows, std::size_t Cols>
+SolutionMap find_combos(const BoardT<Rows, Cols>& b, int max_depth = MAX_DEPTH, bool smart_populate = false, int num_to_populate = dfs::NUM_TO_POPULATE,
+                        int beam_width = BEAM_WIDTH, ThreadPool* pool = nullptr,
+                        dfs::Clock::time_point deadline = dfs::Clock::time_point::max()) {
+    int max_combos = max_combos_possible(b);
+    max_depth = dfs::clamp_depth(max_depth);
+
+    using Node = detail::Node<Rows, Cols>;
+    SolutionMap map = dfs::empty_solution_map<Rows, Cols>({0, 0});
+
+    std::vector<Node> beam;
+    for(const Coord& c : dfs::get_starting_points(b, smart_populate, num_to_populate)) {
+        // Action::up here is just a stub.
+        beam.push_back(Node { make_search_state(b, c), Solution(c), Action::up, 0, 0 });
+    }
+
+#ifdef MULTITHREAD
+    std::unique_ptr<ThreadPool> own_pool;
+    if(!pool) {
+        own_pool.reset(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+        pool = own_pool.get();
+    }
+    int num_threads = pool->size();
+#endif
+
+    std::vector<Node> children;
+    for(int depth = 1; depth <= max_depth && !beam.empty() && dfs::Clock::now() < deadline; depth++) {
+        children.clear();
+#ifdef MULTITHREAD
+        size_t num_chunks = std::min<size_t>(num_threads, beam.size() / MIN_PARALLEL_CHUNK + 1);
+        if(num_chunks > 1) {
+            std::vector<std::future<std::vector<Node>>> results;
+            size_t chunk = (beam.size() + num_chunks - 1) / num_chunks;
+            for(size_t first = 0; first < beam.size(); first += chunk) {
+                size_t last = std::min(beam.size(), first + chunk);
+                results.push_back( pool->enqueue( [&beam](size_t first, size_t last) {
+                        std::vector<Node> part;
+                        part.reserve((last - first) * 3);
+                        detail::expand(beam, first, last, part);
+                        return part;
+                    }, first, last)
+                );
+            }
+            // Chunks are concatenated in order, so the result does not depend on scheduling.
+            for(auto& f : results) {
+                auto part = f.get();
+                std::move(part.begin(), part.end(), std::back_inserter(children));
+            }
+        }
+        else
+#endif
+        detail::expand(beam, 0, beam.size(), children);
+
+        // All children have the same length, so the first depth a score shows up at is the shortest.
+        bool found_max = false;
+        for(const Node& n : children) {
+            if(map[n.score].size() == 0) {
+                map[n.score] = n.sol;
+                map[n.score].set_value(n.score);
+            }
+            found_max |= (n.score == max_combos);
+        }
+        // We cannot get any higher than max_combos, and anything found later would be longer.
+        if(found_max)
+            break;
+
+        // Keep the best beam_width distinct states. Different paths often lead to the same state,
+        // and keeping duplicates would only waste the beam.
+        std::sort(children.begin(), children.end(), [] (const Node& a, const Node& b) {
+            if(a.rank != b.rank)
+                return a.rank > b.rank;
+            return state_key(a.state) < state_key(b.state);
+        });
+        beam.clear();
+        for(size_t i = 0; i < children.size() && beam.size() < size_t(beam_width); i++) {
+            if(!beam.empty() && state_key(beam.back().state) == state_key(children[i].state))
+                continue;
+            beam.push_back(std::move(children[i]));
+        }
+    }
+    return map;
+}
+
+} // namespace beam
+} // namespace pad
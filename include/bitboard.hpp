@@ -0,0 +1,271 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include "detail.hpp"
+#include "state.hpp"
+#include "action.hpp"
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/**
+ * An alternative representation of the board: one bitmask ("plane") per orb type.
+ *
+ * Cells are laid out column-major, i.e. cell (row, col) lives at bit (col * NUM_ROWS + row).
+ * This keeps every column contiguous (which makes skyfall a per-column compaction) while
+ * horizontal neighbors are simply NUM_ROWS bits apart.
+ * A 4x5 or 5x6 plane fits in a single 32-bit word, so the whole board is 7 words;
+ * a 6x7 board needs 64-bit planes.
+ */
+
+namespace pad {
+
+template <std::size_t Rows, std::size_t Cols>
+using MaskT = std::conditional_t<Rows * Cols <= 32, std::uint32_t, std::uint64_t>;
+
+using Mask = MaskT<consts::NUM_ROWS, consts::NUM_COLS>;
+
+namespace consts {
+
+// One plane per orb type, including Orb::empty.
+static const int NUM_PLANES = 7;
+
+} // namespace consts
+
+namespace detail {
+// The given column bits (at the bottom of the word), repeated in every column.
+template <typename M>
+inline constexpr M repeat_column(M column_bits, int rows, int cols) noexcept {
+    M m = 0;
+    for(int j = 0; j < cols; j++)
+        m |= column_bits << (j * rows);
+    return m;
+}
+} // namespace detail
+
+// Where every cell lives in a plane, and the masks the kernels need, for a Rows x Cols board.
+template <std::size_t Rows, std::size_t Cols>
+struct Layout : Dims<Rows, Cols> {
+    using D = Dims<Rows, Cols>;
+    using Mask = MaskT<Rows, Cols>;
+
+    static constexpr int cell_index(int row, int col) noexcept {
+        return col * D::NUM_ROWS + row;
+    }
+    static constexpr Mask cell_bit(int row, int col) noexcept {
+        return Mask(1) << cell_index(row, col);
+    }
+    static constexpr Mask cell_bit(const Coord& coord) noexcept {
+        return cell_bit(coord.first, coord.second);
+    }
+
+    // All the bits that correspond to a cell on the board.
+    static constexpr Mask BOARD_MASK = Mask(~Mask(0)) >> (8 * sizeof(Mask) - D::NUM_ORBS);
+
+    // The bits of a single column, shifted down to the bottom of the word.
+    static constexpr Mask COLUMN_MASK = (Mask(1) << D::NUM_ROWS) - 1;
+
+    // The top and bottom row of every column. Used to stop vertical shifts from wrapping into
+    // the neighboring column.
+    static constexpr Mask TOP_ROW = detail::repeat_column<Mask>(1, D::NUM_ROWS, D::NUM_COLS);
+    static constexpr Mask BOTTOM_ROW = TOP_ROW << (D::NUM_ROWS - 1);
+
+    // Cells from which a vertical run of MIN_ORB_COMBO can start (i.e. not too close to the bottom).
+    static constexpr Mask VERTICAL_RUN_STARTS = detail::repeat_column<Mask>(
+        (Mask(1) << (D::NUM_ROWS - consts::MIN_ORB_COMBO + 1)) - 1, D::NUM_ROWS, D::NUM_COLS);
+};
+
+namespace consts {
+
+// All the bits that correspond to a cell on the default board.
+static const Mask BOARD_MASK = Layout<NUM_ROWS, NUM_COLS>::BOARD_MASK;
+
+} // namespace consts
+
+namespace detail {
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+inline constexpr int cell_index(int row, int col) noexcept {
+    return Layout<Rows, Cols>::cell_index(row, col);
+}
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+inline constexpr MaskT<Rows, Cols> cell_bit(int row, int col) noexcept {
+    return Layout<Rows, Cols>::cell_bit(row, col);
+}
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+inline constexpr MaskT<Rows, Cols> cell_bit(const Coord& coord) noexcept {
+    return Layout<Rows, Cols>::cell_bit(coord);
+}
+
+inline int popcount(std::uint32_t m) noexcept {
+    return __builtin_popcount(m);
+}
+
+inline int popcount(std::uint64_t m) noexcept {
+    return __builtin_popcountll(m);
+}
+
+// Software versions of the BMI2 bit extract/deposit instructions, for CPUs (and compilers) without them.
+// pext gathers the bits of src selected by mask into the low bits of the result.
+template <typename M>
+inline M pext_portable(M src, M mask) noexcept {
+    M res = 0;
+    for(M bit = 1; mask; bit <<= 1) {
+        if(src & mask & (~mask + 1))
+            res |= bit;
+        mask &= mask - 1;
+    }
+    return res;
+}
+
+// pdep scatters the low bits of src into the positions selected by mask.
+template <typename M>
+inline M pdep_portable(M src, M mask) noexcept {
+    M res = 0;
+    for(M bit = 1; mask; bit <<= 1) {
+        if(src & bit)
+            res |= mask & (~mask + 1);
+        mask &= mask - 1;
+    }
+    return res;
+}
+
+inline std::uint32_t pext(std::uint32_t src, std::uint32_t mask) noexcept {
+#ifdef __BMI2__
+    return _pext_u32(src, mask);
+#else
+    return pext_portable(src, mask);
+#endif
+}
+
+inline std::uint64_t pext(std::uint64_t src, std::uint64_t mask) noexcept {
+#ifdef __BMI2__
+    return _pext_u64(src, mask);
+#else
+    return pext_portable(src, mask);
+#endif
+}
+
+inline std::uint32_t pdep(std::uint32_t src, std::uint32_t mask) noexcept {
+#ifdef __BMI2__
+    return _pdep_u32(src, mask);
+#else
+    return pdep_portable(src, mask);
+#endif
+}
+
+inline std::uint64_t pdep(std::uint64_t src, std::uint64_t mask) noexcept {
+#ifdef __BMI2__
+    return _pdep_u64(src, mask);
+#else
+    return pdep_portable(src, mask);
+#endif
+}
+
+} // namespace detail
+
+template <std::size_t Rows, std::size_t Cols>
+struct BitBoardT {
+    using Mask = MaskT<Rows, Cols>;
+
+    std::array<Mask, consts::NUM_PLANES> planes;
+
+    Mask& operator[](Orb o) noexcept {
+        return planes[detail::enum_value(o)];
+    }
+    const Mask& operator[](Orb o) const noexcept {
+        return planes[detail::enum_value(o)];
+    }
+    bool operator==(const BitBoardT& other) const noexcept {
+        return planes == other.planes;
+    }
+    bool operator!=(const BitBoardT& other) const noexcept {
+        return planes != other.planes;
+    }
+};
+
+using BitBoard = BitBoardT<consts::NUM_ROWS, consts::NUM_COLS>;
+
+template <std::size_t Rows, std::size_t Cols>
+struct board_dims<BitBoardT<Rows, Cols>> : Dims<Rows, Cols> {};
+
+template <std::size_t Rows, std::size_t Cols>
+BitBoardT<Rows, Cols> to_bitboard(const BoardT<Rows, Cols>& b) noexcept {
+    using L = Layout<Rows, Cols>;
+    BitBoardT<Rows, Cols> bb;
+    bb.planes.fill(0);
+    for(int i = 0; i < L::NUM_ROWS; i++) {
+        for(int j = 0; j < L::NUM_COLS; j++) {
+            bb[b[i][j]] |= L::cell_bit(i, j);
+        }
+    }
+    return bb;
+}
+
+// IMPORTANT: assumes the planes partition the board, i.e. every cell is in exactly one plane.
+template <std::size_t Rows, std::size_t Cols>
+BoardT<Rows, Cols> to_board(const BitBoardT<Rows, Cols>& bb) noexcept {
+    using L = Layout<Rows, Cols>;
+    BoardT<Rows, Cols> b;
+    for(int i = 0; i < L::NUM_ROWS; i++) {
+        for(int j = 0; j < L::NUM_COLS; j++) {
+            auto bit = L::cell_bit(i, j);
+            for(int k = 0; k < consts::NUM_PLANES; k++) {
+                if(bb.planes[k] & bit) {
+                    b[i][j] = Orb(k);
+                    break;
+                }
+            }
+        }
+    }
+    return b;
+}
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+BitBoardT<Rows, Cols> initialize_bitboard(const std::string& board_string) {
+    return to_bitboard(initialize<Rows, Cols>(board_string));
+}
+
+template <std::size_t Rows, std::size_t Cols>
+inline Orb orb_at(const BitBoardT<Rows, Cols>& bb, const Coord& coord) noexcept {
+    auto bit = Layout<Rows, Cols>::cell_bit(coord);
+    int k = 0;
+    for(; k < consts::NUM_PLANES - 1; k++) {
+        if(bb.planes[k] & bit)
+            break;
+    }
+    return Orb(k);
+}
+
+// Swapping two cells only touches the (at most two) planes the orbs live in.
+template <std::size_t Rows, std::size_t Cols>
+inline void swap_orbs(BitBoardT<Rows, Cols>& bb, const Coord& a, const Coord& b) noexcept {
+    using L = Layout<Rows, Cols>;
+    Orb oa = orb_at(bb, a);
+    Orb ob = orb_at(bb, b);
+    if(oa == ob)
+        return;
+    auto both = L::cell_bit(a) | L::cell_bit(b);
+    bb[oa] ^= both;
+    bb[ob] ^= both;
+}
+
+// Same contract as move() on a Board.
+template <std::size_t Rows, std::size_t Cols>
+BitBoardT<Rows, Cols> move(const BitBoardT<Rows, Cols>& board, const Coord& old_coord, const Coord& new_coord) {
+#ifdef CHECK_BOUND
+    int check = check_move<Rows, Cols>(new_coord);
+    if (check)
+        throw std::logic_error("CHECK_BOUND detected out of bounds coordinate at move().");
+#endif
+    BitBoardT<Rows, Cols> new_board = board;
+    swap_orbs(new_board, old_coord, new_coord);
+    return new_board;
+}
+
+} // namespace pad
@@ -1,5 +1,6 @@
 #pragma once
 #include <map>
+#include <stdexcept>
 /** 
  * Some utility for the main header files 
  */
@@ -11,10 +11,11 @@
 namespace pad {
 namespace display {
 
-std::string board_string(const Board& b) {
+template <std::size_t Rows, std::size_t Cols>
+std::string board_string(const BoardT<Rows, Cols>& b) {
     std::string s; // empty initialization
-    for (int i = 0; i < pad::consts::NUM_ROWS; i++) {
-        for (int j = 0; j < pad::consts::NUM_COLS; j++) {
+    for (int i = 0; i < Dims<Rows, Cols>::NUM_ROWS; i++) {
+        for (int j = 0; j < Dims<Rows, Cols>::NUM_COLS; j++) {
             s += pad::detail::get_value(pad::consts::ORB_TO_CHAR, b[i][j]);
             s += ' ';
         }
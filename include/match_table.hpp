@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "state.hpp"
+
+/**
+ * Lookup tables for matches along a single row or column.
+ *
+ * The cells of one row that hold a given color form one of 2^NUM_COLS patterns (bit j set if column j
+ * holds it), and the same goes for a column with 2^NUM_ROWS patterns. The tables map every pattern to
+ * its cells that are part of a run of at least MIN_ORB_COMBO, so finding the matches of a line is a
+ * single lookup instead of a scan with a branch per cell. They are built at compile time, and even the
+ * 7 wide one is only 128 bytes.
+ *
+ * The bitboard kernels don't need them: shifting and AND-ing whole planes finds the runs of every
+ * row and column at once (see detail::match_mask).
+ */
+
+namespace pad {
+
+namespace detail {
+
+// The cells of a length bits long pattern that belong to a run of at least MIN_ORB_COMBO.
+inline constexpr std::uint8_t scan_runs(unsigned pattern, int length) noexcept {
+    std::uint8_t matched = 0;
+    int start = 0;
+    for(int i = 0; i <= length; i++) {
+        if(i < length && ((pattern >> i) & 1))
+            continue;
+        if(i - start >= consts::MIN_ORB_COMBO)
+            matched |= ((1u << (i - start)) - 1) << start;
+        start = i + 1;
+    }
+    return matched;
+}
+
+template <std::size_t Length>
+inline constexpr std::array<std::uint8_t, (1 << Length)> make_run_table() noexcept {
+    std::array<std::uint8_t, (1 << Length)> table {};
+    for(unsigned pattern = 0; pattern < table.size(); pattern++)
+        table[pattern] = scan_runs(pattern, Length);
+    return table;
+}
+
+} // namespace detail
+
+template <std::size_t Rows, std::size_t Cols>
+struct MatchTable {
+    static_assert(Rows <= 8 && Cols <= 8, "a line's pattern has to fit in a byte");
+
+    // Indexed by the columns of a row that hold the color.
+    static constexpr std::array<std::uint8_t, (1 << Cols)> ROW = detail::make_run_table<Cols>();
+    // Indexed by the rows of a column that hold the color.
+    static constexpr std::array<std::uint8_t, (1 << Rows)> COLUMN = detail::make_run_table<Rows>();
+};
+
+} // namespace pad
@@ -0,0 +1,229 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "solver.hpp"
+
+/**
+ * One board to solve and how, as padsolve and padsolved take them, and the line that answers it.
+ *
+ * A request line is the board followed by any number of key=value options, e.g.
+ *
+ *   HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=12 deadline_ms=50
+ *
+ * and anything it doesn't set keeps the defaults it was parsed against. The board is the string
+ * initialize() takes, with 20, 30 or 42 orbs for 4x5, 5x6 and 6x7.
+ *
+ * The answer is "board combos row,col path" for the path with the most combos, or with json one
+ * object with the path for every combo count. A request that cannot be solved gets
+ * "board error message" (or {"board":...,"error":...}) instead, so every request gets exactly one line.
+ */
+
+namespace pad {
+namespace request {
+
+enum class Algorithm { dfs, beam };
+
+// The most a request line can ask for, whoever answers it. Past these it gets an error instead.
+static const long MAX_DEADLINE_MS = 24L * 60 * 60 * 1000;
+static const long MAX_BEAM_WIDTH = 1000000;
+
+struct Request {
+    std::string board;
+    Algorithm algorithm = Algorithm::dfs;
+    int depth = 10;
+    int beam_width = beam::BEAM_WIDTH;
+    // With a deadline, dfs deepens iteratively until then instead of searching depth right away,
+    // see find_combos_until, and beam search stops at the first depth that starts past it. 0 for none.
+    long deadline_ms = 0;
+    bool smart = false;
+    // Cuts subtrees by dfs::heuristic_bound(), which is faster but can miss the best path.
+    bool bound = false;
+    bool json = false;
+};
+
+inline bool parse_algorithm(const std::string& name, Algorithm& algorithm) {
+    if(name == "dfs")
+        algorithm = Algorithm::dfs;
+    else if(name == "beam")
+        algorithm = Algorithm::beam;
+    else
+        return false;
+    return true;
+}
+
+namespace detail {
+
+inline bool parse_number(const std::string& s, long& n) {
+    char* end;
+    n = std::strtol(s.c_str(), &end, 10);
+    return !s.empty() && !*end && n >= 0;
+}
+
+inline std::string json_escape(const std::string& s) {
+    std::string out;
+    for(char c : s) {
+        if(c == '"' || c == '\\')
+            out.push_back('\\');
+        if(static_cast<unsigned char>(c) < 0x20)
+            continue;
+        out.push_back(c);
+    }
+    return out;
+}
+
+inline std::string path_string(const Solution& sol) {
+    std::string path;
+    for(int i = 0; i < sol.size(); i++)
+        path.push_back(pad::detail::get_value(consts::ACTION_TO_CHAR, sol.get_action(i)));
+    return path;
+}
+
+} // namespace detail
+
+// What a server lets its clients ask for, on top of the above, so that no request holds a thread for
+// longer than max_deadline_ms (or much memory, for beam search). A request with no deadline (or a
+// later one) gets max_deadline_ms. 0 for no maximum deadline.
+struct Limits {
+    int max_depth = Solution::MAX_LENGTH;
+    long max_beam_width = MAX_BEAM_WIDTH;
+    long max_deadline_ms = 0;
+};
+
+// Fills req from a request line, on top of whatever it already holds. Returns what is wrong with the
+// line, or an empty string.
+inline std::string parse(const std::string& line, Request& req) {
+    std::istringstream ss(line);
+    ss >> req.board;
+    std::string option;
+    while(ss >> option) {
+        size_t eq = option.find('=');
+        std::string key = option.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : option.substr(eq + 1);
+        long n = 0;
+        bool on = value.empty() || value == "1" || value == "true";
+        if(key == "json") {
+            req.json = on;
+        } else if(key == "smart") {
+            req.smart = on;
+        } else if(key == "bound") {
+            req.bound = on;
+        } else if(key == "algorithm") {
+            if(!parse_algorithm(value, req.algorithm))
+                return "unknown algorithm " + value;
+        } else if(key == "depth" || key == "width" || key == "deadline_ms") {
+            if(!detail::parse_number(value, n))
+                return "bad value for " + key;
+            // Checked before narrowing n, so that e.g. depth=4294967295 doesn't come out as -1.
+            if(key == "depth") {
+                if(n > Solution::MAX_LENGTH)
+                    return "depth must be 0 to " + std::to_string(Solution::MAX_LENGTH);
+                req.depth = n;
+            } else if(key == "width") {
+                if(n > MAX_BEAM_WIDTH)
+                    return "width must be 1 to " + std::to_string(MAX_BEAM_WIDTH);
+                req.beam_width = std::max(1L, n);
+            } else {
+                if(n > MAX_DEADLINE_MS)
+                    return "deadline_ms must be 0 to " + std::to_string(MAX_DEADLINE_MS);
+                req.deadline_ms = n;
+            }
+        } else {
+            return "unknown option " + key;
+        }
+    }
+    return "";
+}
+
+inline std::string format_error(const Request& req, const std::string& message) {
+    if(req.json)
+        return "{\"board\":\"" + detail::json_escape(req.board) + "\",\"error\":\"" + detail::json_escape(message) + "\"}";
+    return req.board + " error " + message;
+}
+
+inline std::string format(const Request& req, const dfs::SolutionMap& map, double ms) {
+    int best = map.size() - 1;
+    while(best >= 0 && map[best].size() == 0)
+        best--;
+    std::ostringstream ss;
+    if(!req.json) {
+        ss << req.board << " ";
+        if(best < 0)
+            ss << "0 - -";
+        else
+            ss << best << " " << map[best].get_origin().first << "," << map[best].get_origin().second << " "
+               << detail::path_string(map[best]);
+        return ss.str();
+    }
+    ss << "{\"board\":\"" << req.board << "\",\"combos\":" << std::max(best, 0) << ",\"ms\":" << ms << ",\"solutions\":[";
+    bool first = true;
+    for(int k = map.size() - 1; k >= 0; k--) {
+        if(map[k].size() == 0)
+            continue;
+        ss << (first ? "" : ",") << "{\"combos\":" << k << ",\"origin\":[" << map[k].get_origin().first << ","
+           << map[k].get_origin().second << "],\"path\":\"" << detail::path_string(map[k]) << "\"}";
+        first = false;
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+template <std::size_t Rows, std::size_t Cols>
+dfs::SolutionMap solve(Solver& solver, const BoardT<Rows, Cols>& b, const Request& req, dfs::Clock::time_point received) {
+    if(req.algorithm == Algorithm::beam) {
+        auto deadline = req.deadline_ms ? received + std::chrono::milliseconds(req.deadline_ms) : dfs::Clock::time_point::max();
+        return solver.beam_find_combos(b, req.depth, req.smart, dfs::NUM_TO_POPULATE, req.beam_width, deadline);
+    }
+    dfs::SearchOptions opts;
+    opts.max_depth = req.depth;
+    opts.smart_populate = req.smart;
+    opts.bound = req.bound;
+    if(req.deadline_ms)
+        return solver.find_combos_until(b, received + std::chrono::milliseconds(req.deadline_ms), opts);
+    return solver.find_combos(b, opts);
+}
+
+// The answer line for req. The deadline counts from received, so time spent waiting in a queue counts too.
+inline std::string solve(Solver& solver, const Request& req, dfs::Clock::time_point received = dfs::Clock::now()) {
+    dfs::SolutionMap map;
+    try {
+        switch(req.board.size()) {
+        case 20:
+            map = solve(solver, initialize<4, 5>(req.board), req, received);
+            break;
+        case 30:
+            map = solve(solver, initialize<5, 6>(req.board), req, received);
+            break;
+        case 42:
+            map = solve(solver, initialize<6, 7>(req.board), req, received);
+            break;
+        default:
+            return format_error(req, "expected 20, 30 or 42 orbs, got " + std::to_string(req.board.size()));
+        }
+    } catch(const std::logic_error&) {
+        return format_error(req, "unknown orb (expected one of l, d, r, b, g, h, e)");
+    }
+    return format(req, map, std::chrono::duration<double, std::milli>(dfs::Clock::now() - received).count());
+}
+
+// Parses and solves a request line within limits, see above.
+inline std::string answer(Solver& solver, const std::string& line, const Request& defaults, const Limits& limits = Limits(),
+                          dfs::Clock::time_point received = dfs::Clock::now()) {
+    Request req = defaults;
+    std::string error = parse(line, req);
+    if(!error.empty())
+        return format_error(req, error);
+    if(req.depth > limits.max_depth)
+        return format_error(req, "depth above this server's maximum of " + std::to_string(limits.max_depth));
+    if(req.algorithm == Algorithm::beam && req.beam_width > limits.max_beam_width)
+        return format_error(req, "width above this server's maximum of " + std::to_string(limits.max_beam_width));
+    if(limits.max_deadline_ms && (!req.deadline_ms || req.deadline_ms > limits.max_deadline_ms))
+        req.deadline_ms = limits.max_deadline_ms;
+    return solve(solver, req, received);
+}
+
+} // namespace request
+} // namespace pad
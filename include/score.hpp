@@ -12,6 +12,8 @@
 #include "detail.hpp"
 #include "state.hpp"
 #include "action.hpp"
+#include "bitboard.hpp"
+#include "match_table.hpp"
 
 namespace pad {
 
@@ -19,12 +21,16 @@ namespace detail {
 // In order for us to correctly compute the number of combos, we need to make a mask
 // for orbs that are already visited and are identified as a match.
 // To do this, it is in our best interest to have a lightweight mask object, shown below:
-using ComboMask = std::array< std::array<bool, consts::NUM_COLS>, consts::NUM_ROWS >; 
+template <std::size_t Rows, std::size_t Cols>
+using ComboMaskT = std::array< std::array<bool, Cols>, Rows >;
 
-ComboMask init_mask() {
-    detail::ComboMask mask;
-    for(int i = 0; i < consts::NUM_ROWS; i++) {
-        for(int j = 0; j < consts::NUM_COLS; j++) {
+using ComboMask = ComboMaskT<consts::NUM_ROWS, consts::NUM_COLS>;
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+ComboMaskT<Rows, Cols> init_mask() {
+    ComboMaskT<Rows, Cols> mask;
+    for(std::size_t i = 0; i < Rows; i++) {
+        for(std::size_t j = 0; j < Cols; j++) {
             mask[i][j] = false;
         }
     } 
@@ -33,9 +39,12 @@ ComboMask init_mask() {
 } // namespace detail
 
 // A node matches if and only if it is connected vertically/horizontally to two orbs of its color.
-// Returns a vector of coordinates along horizontal or vertical axis.
-// IMPORTANT: We also modify the board by replacing the orbs with empties.
-void remove_match(Board& b, detail::ComboMask& mask, const Coord& coord) {
+// Marks every match of the orb's color in its row and column in the mask, which is a lookup per line
+// (see match_table.hpp) once we know which cells of the line hold the color.
+template <std::size_t Rows, std::size_t Cols>
+void remove_match(BoardT<Rows, Cols>& b, detail::ComboMaskT<Rows, Cols>& mask, const Coord& coord) {
+    using D = Dims<Rows, Cols>;
+    using T = MatchTable<Rows, Cols>;
     int row = coord.first;
     int col = coord.second;
     const Orb& o = b[row][col];
@@ -45,30 +54,25 @@ void remove_match(Board& b, detail::ComboMask& mask, const Coord& coord) {
         return;
     }
 
-    // Preliminary runs
-    int r = row; 
-    for(; r < consts::NUM_ROWS; r++)
-        if(b[r][col] != o)
-            break;
-    
-    int c = col;
-    for(; c < consts::NUM_COLS; c++)
-        if(b[row][c] != o)
-            break;
+    unsigned row_pattern = 0;
+    for(int j = 0; j < D::NUM_COLS; j++)
+        row_pattern |= unsigned(b[row][j] == o) << j;
+    unsigned col_pattern = 0;
+    for(int i = 0; i < D::NUM_ROWS; i++)
+        col_pattern |= unsigned(b[i][col] == o) << i;
 
-    // Remove the orbs from the board
-    if(r - row >= consts::MIN_ORB_COMBO)
-        for(int i = row; i < r; i++)
-            mask[i][col] = true;
-    
-    if(c - col >= consts::MIN_ORB_COMBO)
-        for(int j = col; j < c; j++)
-            mask[row][j] = true;
+    unsigned h = T::ROW[row_pattern];
+    unsigned v = T::COLUMN[col_pattern];
+    for(int j = 0; j < D::NUM_COLS; j++)
+        mask[row][j] |= (h >> j) & 1;
+    for(int i = 0; i < D::NUM_ROWS; i++)
+        mask[i][col] |= (v >> i) & 1;
 }
 
 namespace detail {
 // IMPORTANT: Assumes that the current coord is not empty.
-void make_empty(Board& b, const detail::ComboMask& mask, const Coord& coord) {
+template <std::size_t Rows, std::size_t Cols>
+void make_empty(BoardT<Rows, Cols>& b, const ComboMaskT<Rows, Cols>& mask, const Coord& coord) {
     int row = coord.first;
     int col = coord.second;
     auto o = b[row][col];
@@ -76,16 +80,16 @@ void make_empty(Board& b, const detail::ComboMask& mask, const Coord& coord) {
     // Remove this orb
     b[row][col] = Orb::empty;
 
-    if(check_move( {row, col+1} ) == 0 && mask[row][col+1] && b[row][col+1] == o) {
+    if(check_move<Rows, Cols>( {row, col+1} ) == 0 && mask[row][col+1] && b[row][col+1] == o) {
         make_empty(b, mask, {row, col+1});
     }
-    if(check_move( {row, col-1} ) == 0 && mask[row][col-1] && b[row][col-1] == o) {
+    if(check_move<Rows, Cols>( {row, col-1} ) == 0 && mask[row][col-1] && b[row][col-1] == o) {
         make_empty(b, mask, {row, col-1});
     }
-    if(check_move( {row+1, col} ) == 0 && mask[row+1][col] && b[row+1][col] == o) {
+    if(check_move<Rows, Cols>( {row+1, col} ) == 0 && mask[row+1][col] && b[row+1][col] == o) {
         make_empty(b, mask, {row+1, col});
     }
-    if(check_move( {row-1, col} ) == 0 && mask[row-1][col] && b[row-1][col] == o) {
+    if(check_move<Rows, Cols>( {row-1, col} ) == 0 && mask[row-1][col] && b[row-1][col] == o) {
         make_empty(b, mask, {row-1, col});
     }
 }
@@ -94,10 +98,11 @@ void make_empty(Board& b, const detail::ComboMask& mask, const Coord& coord) {
 // IMPORTANT: mask is assumed to be computed properly, i.e.
 // every element in the mask should be empty after, and is actually
 // a part of a combo.
-int clear_combos(Board& b, const detail::ComboMask& mask) {
+template <std::size_t Rows, std::size_t Cols>
+int clear_combos(BoardT<Rows, Cols>& b, const detail::ComboMaskT<Rows, Cols>& mask) {
     int combos = 0;
-    for(int i = 0; i < consts::NUM_ROWS; i++){
-        for(int j = 0; j < consts::NUM_COLS; j++){
+    for(int i = 0; i < int(Rows); i++){
+        for(int j = 0; j < int(Cols); j++){
             // This orb has already been matched
             // or this is not an orb belonging to a combo.
             if(b[i][j] == Orb::empty || !mask[i][j])
@@ -111,12 +116,13 @@ int clear_combos(Board& b, const detail::ComboMask& mask) {
 }
 
 // Skyfall is when the orbs are cleared and consequent orbs above it moves down.
-// Since the board is a simple 5x6, we don't need to worry about cache coherence here.
-void skyfall(Board& b) {
-    for(int col = 0; col < consts::NUM_COLS; col++) {
+// Since the board is at most 6x7, we don't need to worry about cache coherence here.
+template <std::size_t Rows, std::size_t Cols>
+void skyfall(BoardT<Rows, Cols>& b) {
+    for(int col = 0; col < int(Cols); col++) {
         // Start from the bottom, and find the first orb available and move it there.
-        int current_row = consts::NUM_ROWS - 1;
-        for(int row = consts::NUM_ROWS - 1; row >= 0; row--) {
+        int current_row = Rows - 1;
+        for(int row = Rows - 1; row >= 0; row--) {
             // while the current orb is empty decrement row until you find one
             // that is not empty.
             if(b[row][col] == Orb::empty)
@@ -126,30 +132,281 @@ void skyfall(Board& b) {
     } 
 }
 
+namespace detail {
+// The bitboard equivalent of running remove_match on every cell: returns every cell of the plane
+// that is part of a horizontal or vertical run of at least MIN_ORB_COMBO.
+// Runs are found by AND-ing the plane with shifted copies of itself, so there are no branches.
+// W is the plane's word, or a vector of planes from several boards (see score_batch()).
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS, typename W = MaskT<Rows, Cols>>
+inline W match_mask(W p) noexcept {
+    using L = Layout<Rows, Cols>;
+    W v = p & L::VERTICAL_RUN_STARTS;
+    W h = p;
+    for(int k = 1; k < consts::MIN_ORB_COMBO; k++) {
+        v &= p >> k;
+        h &= p >> (k * L::NUM_ROWS);
+    }
+    W m = v | h;
+    for(int k = 1; k < consts::MIN_ORB_COMBO; k++) {
+        m |= (v << k) | (h << (k * L::NUM_ROWS));
+    }
+    return m;
+}
+
+// Every cell orthogonally adjacent to a cell in x.
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS, typename W = MaskT<Rows, Cols>>
+inline W neighbors(W x) noexcept {
+    using L = Layout<Rows, Cols>;
+    return ((x >> 1) & ~L::BOTTOM_ROW) |
+           ((x << 1) & ~L::TOP_ROW) |
+           (x >> L::NUM_ROWS) |
+           ((x << L::NUM_ROWS) & L::BOARD_MASK);
+}
+
+// The bitboard equivalent of clear_combos: every 4-connected region of matched orbs is one combo.
+// Each region is grown from its lowest bit with whole-mask dilations instead of a recursive DFS.
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+inline int count_components(MaskT<Rows, Cols> m) noexcept {
+    using M = MaskT<Rows, Cols>;
+    int combos = 0;
+    while(m) {
+        M region = m & (~m + 1);
+        M prev;
+        do {
+            prev = region;
+            region = (region | neighbors<Rows, Cols>(region)) & m;
+        } while(region != prev);
+        m &= ~region;
+        combos++;
+    }
+    return combos;
+}
+
+// Calls f(region) on every 4-connected region of m, grown the same way as in count_components.
+template <std::size_t Rows, std::size_t Cols, typename F>
+inline void for_each_component(MaskT<Rows, Cols> m, F&& f) {
+    using M = MaskT<Rows, Cols>;
+    while(m) {
+        M region = m & (~m + 1);
+        M prev;
+        do {
+            prev = region;
+            region = (region | neighbors<Rows, Cols>(region)) & m;
+        } while(region != prev);
+        m &= ~region;
+        f(region);
+    }
+}
+
+// The cells of x whose neighbor in the given direction is also in x.
+template <std::size_t Rows, std::size_t Cols>
+inline MaskT<Rows, Cols> with_below(MaskT<Rows, Cols> x) noexcept {
+    return x & (x >> 1) & ~Layout<Rows, Cols>::BOTTOM_ROW;
+}
+template <std::size_t Rows, std::size_t Cols>
+inline MaskT<Rows, Cols> with_above(MaskT<Rows, Cols> x) noexcept {
+    return x & (x << 1) & ~Layout<Rows, Cols>::TOP_ROW;
+}
+template <std::size_t Rows, std::size_t Cols>
+inline MaskT<Rows, Cols> with_right(MaskT<Rows, Cols> x) noexcept {
+    return x & (x >> Rows);
+}
+template <std::size_t Rows, std::size_t Cols>
+inline MaskT<Rows, Cols> with_left(MaskT<Rows, Cols> x) noexcept {
+    return x & (x << Rows);
+}
+} // namespace detail
+
+/**
+ * The shapes that awakenings and leader skills care about. A combo only has one: a full row wins over
+ * everything else, and the rest are about the exact shape of the combo, so a 5-orb line is plain.
+ */
+enum class Shape : std::uint8_t {
+    plain = 0,
+    tpa = 1,     // Exactly 4 orbs in a line ("two-pronged attack").
+    row = 2,     // Covers a whole row of the board.
+    cross = 3,   // Exactly 5 orbs in a plus.
+    l_shape = 4, // Exactly 5 orbs, 3 in a column and 3 in a row that share an end.
+};
+
+template <std::size_t Rows, std::size_t Cols>
+Shape shape_of(MaskT<Rows, Cols> region) noexcept {
+    using L = Layout<Rows, Cols>;
+    using M = MaskT<Rows, Cols>;
+    for(int row = 0; row < L::NUM_ROWS; row++) {
+        M r = L::TOP_ROW << row;
+        if((region & r) == r)
+            return Shape::row;
+    }
+    int n = detail::popcount(region);
+    if(n == 4) {
+        M down = detail::with_below<Rows, Cols>(region);
+        M right = detail::with_right<Rows, Cols>(region);
+        // 3 cells with a neighbor below (or to the right) means the 4 of them are one line.
+        if(detail::popcount(down) == 3 || detail::popcount(right) == 3)
+            return Shape::tpa;
+    } else if(n == 5) {
+        M down = detail::with_below<Rows, Cols>(region), up = detail::with_above<Rows, Cols>(region);
+        M right = detail::with_right<Rows, Cols>(region), left = detail::with_left<Rows, Cols>(region);
+        if(down & up & right & left)
+            return Shape::cross;
+        // The corner of an L has two cells in a line in one vertical and one horizontal direction.
+        M vertical = (down & (down >> 1) & ~L::BOTTOM_ROW) | (up & (up << 1) & ~L::TOP_ROW);
+        M horizontal = (right & (right >> Rows)) | (left & (left << Rows));
+        if(vertical & horizontal)
+            return Shape::l_shape;
+    }
+    return Shape::plain;
+}
+
+// One combo, as reported to the visitor of score().
+struct Combo {
+    Orb orb;
+    int count;
+    Shape shape;
+    // 0 for the combos we made ourselves, 1 for the first cascade after skyfall, and so on.
+    int wave;
+};
+
+// Finds all matches on the board, moves the matched orbs into the empty plane,
+// and returns the number of combos that were cleared.
+template <std::size_t Rows, std::size_t Cols>
+inline int clear_matches(BitBoardT<Rows, Cols>& bb) noexcept {
+    int combos = 0;
+    for(int k = 0; k < consts::NUM_PLANES; k++) {
+        if(Orb(k) == Orb::empty)
+            continue;
+        auto m = detail::match_mask<Rows, Cols>(bb.planes[k]);
+        combos += detail::count_components<Rows, Cols>(m);
+        bb.planes[k] &= ~m;
+        bb[Orb::empty] |= m;
+    }
+    return combos;
+}
+
+// Same as clear_matches, but also calls visitor(const Combo&) for every combo cleared.
+template <std::size_t Rows, std::size_t Cols, typename Visitor>
+inline int clear_matches(BitBoardT<Rows, Cols>& bb, Visitor& visitor, int wave) {
+    int combos = 0;
+    for(int k = 0; k < consts::NUM_PLANES; k++) {
+        if(Orb(k) == Orb::empty)
+            continue;
+        auto m = detail::match_mask<Rows, Cols>(bb.planes[k]);
+        detail::for_each_component<Rows, Cols>(m, [&](MaskT<Rows, Cols> region) {
+            visitor(Combo{Orb(k), detail::popcount(region), shape_of<Rows, Cols>(region), wave});
+            combos++;
+        });
+        bb.planes[k] &= ~m;
+        bb[Orb::empty] |= m;
+    }
+    return combos;
+}
+
+// Same as clear_matches, for when the matches of every plane are already known.
+template <std::size_t Rows, std::size_t Cols>
+inline int clear_matches(BitBoardT<Rows, Cols>& bb, const std::array<MaskT<Rows, Cols>, consts::NUM_PLANES>& matched) noexcept {
+    int combos = 0;
+    for(int k = 0; k < consts::NUM_PLANES; k++) {
+        if(Orb(k) == Orb::empty)
+            continue;
+        combos += detail::count_components<Rows, Cols>(matched[k]);
+        bb.planes[k] &= ~matched[k];
+        bb[Orb::empty] |= matched[k];
+    }
+    return combos;
+}
+
+// Same as skyfall on a Board: every column's orbs fall to the bottom, empties rise to the top.
+// Because the layout is column-major, extracting the surviving bits of a plane with pext lines up
+// every column's survivors in order, and depositing them with pdep into the bottom cells of each
+// column performs the fall for all columns at once.
+template <std::size_t Rows, std::size_t Cols>
+void skyfall(BitBoardT<Rows, Cols>& bb) noexcept {
+    using L = Layout<Rows, Cols>;
+    using M = MaskT<Rows, Cols>;
+    M keep = ~bb[Orb::empty] & L::BOARD_MASK;
+    // Where the survivors end up: the bottom popcount(column) cells of every column.
+    M dest = 0;
+    for(int col = 0; col < L::NUM_COLS; col++) {
+        int n = detail::popcount(M((keep >> (col * L::NUM_ROWS)) & L::COLUMN_MASK));
+        dest |= M((L::COLUMN_MASK << (L::NUM_ROWS - n)) & L::COLUMN_MASK) << (col * L::NUM_ROWS);
+    }
+    for(int k = 0; k < consts::NUM_PLANES; k++) {
+        if(Orb(k) == Orb::empty)
+            continue;
+        bb.planes[k] = detail::pdep(detail::pext(bb.planes[k], keep), dest);
+    }
+    bb[Orb::empty] = L::BOARD_MASK & ~dest;
+}
+
 /**
  * Scoring the board is actually quite an involved process. We need to simulate it due to the 
  * complexity of the scoring otherwise.
  *
- * For now, we score by the number of combos but future suggestions would be weighted total of
- * combo multipliers(reliant on color).
+ * This scores by the number of combos. Anything that depends on what the combos were (weighted by
+ * color, shapes, ...) goes through the visitor overload below, see scoring.hpp.
  */
-int score(Board& b) {
+template <std::size_t Rows, std::size_t Cols>
+int score(BitBoardT<Rows, Cols>& bb) noexcept {
+    int score = 0;
+    int combo;
+    do {
+        combo = clear_matches(bb);
+        score += combo;
+        if(combo)
+            skyfall(bb);
+    } while(combo);
+    return score;
+}
+
+// Same as score(), when the first wave's matches are already known (see SearchStateT).
+template <std::size_t Rows, std::size_t Cols>
+int score_from_matches(BitBoardT<Rows, Cols>& bb, const std::array<MaskT<Rows, Cols>, consts::NUM_PLANES>& matched) noexcept {
+    int score = clear_matches(bb, matched);
+    if(!score)
+        return 0;
+    skyfall(bb);
+    return score + pad::score(bb);
+}
+
+// Same as score_from_matches(), and also counts the waves that cleared something (see SearchStats).
+template <std::size_t Rows, std::size_t Cols>
+int score_from_matches(BitBoardT<Rows, Cols>& bb, const std::array<MaskT<Rows, Cols>, consts::NUM_PLANES>& matched,
+                       int& waves) noexcept {
+    waves = 0;
+    int score = clear_matches(bb, matched);
+    int combo = score;
+    while(combo) {
+        waves++;
+        skyfall(bb);
+        combo = clear_matches(bb);
+        score += combo;
+    }
+    return score;
+}
+
+// Same as score(), but calls visitor(const Combo&) for every combo as it is cleared, wave by wave.
+// The plain overload doesn't pay for any of it.
+template <std::size_t Rows, std::size_t Cols, typename Visitor>
+int score(BitBoardT<Rows, Cols>& bb, Visitor&& visitor) {
     int score = 0;
     int combo;
+    int wave = 0;
     do {
-        detail::ComboMask mask = detail::init_mask();
-        for(int i = 0; i < consts::NUM_ROWS; i++) {
-            for(int j = 0; j < consts::NUM_COLS; j++) {
-                remove_match(b, mask, Coord {i, j});
-            }
-        } 
-        // std::cout << display::board_string(b) << std::endl;
-        combo = clear_combos(b, mask); 
-        // std::cout << "and then after clearing combos : \n" << display::board_string(b) << std::endl;
+        combo = clear_matches(bb, visitor, wave++);
         score += combo;
-        skyfall(b);
-        // std::cout << "and then after skyfalls : \n" << display::board_string(b) << std::endl;
+        if(combo)
+            skyfall(bb);
     } while(combo);
-    return score;  
+    return score;
+}
+
+// The array board is only used as the interface here, the simulation itself runs on the bitboard.
+template <std::size_t Rows, std::size_t Cols>
+int score(BoardT<Rows, Cols>& b) {
+    auto bb = to_bitboard(b);
+    int s = score(bb);
+    b = to_board(bb);
+    return s;
 }
 } // namespace pad
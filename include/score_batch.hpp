@@ -0,0 +1,160 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "detail.hpp"
+#include "state.hpp"
+#include "bitboard.hpp"
+#include "score.hpp"
+
+/**
+ * Scores many boards at once. The planes of LANES boards are transposed into one vector per orb
+ * type, so every shift and AND of the bitboard kernels works on all of them in a single instruction:
+ * 16 boards per AVX-512 register, 8 per AVX2 register (half that for 64-bit planes).
+ *
+ * The vectors are GCC vector extensions, so without AVX the compiler falls back to narrower vectors
+ * or plain scalar code, and the results are the same everywhere.
+ *
+ * There is no vector pext/pdep, so skyfall moves every orb that has an empty cell below it down by
+ * one cell at a time (a "sand step") until nothing moves. Boards that stopped cascading are masked
+ * out, so every lane ends up with exactly what score() returns.
+ */
+
+namespace pad {
+
+namespace consts {
+#if defined(__AVX512F__)
+static const std::size_t VECTOR_BYTES = 64;
+#elif defined(__AVX2__)
+static const std::size_t VECTOR_BYTES = 32;
+#else
+static const std::size_t VECTOR_BYTES = 16;
+#endif
+} // namespace consts
+
+namespace detail {
+
+// One plane of LANES boards.
+template <typename M>
+struct Lanes {
+    typedef M type __attribute__((vector_size(consts::VECTOR_BYTES)));
+    static constexpr std::size_t SIZE = consts::VECTOR_BYTES / sizeof(M);
+};
+
+// No early exit, so this compiles to a reduction instead of a chain of branches.
+template <typename V>
+inline bool any_lane(V v) noexcept {
+    auto acc = v[0];
+    for(std::size_t i = 1; i < sizeof(V) / sizeof(v[0]); i++)
+        acc |= v[i];
+    return acc != 0;
+}
+
+// count_components on every lane of every plane, summed. The regions of all planes and lanes are grown
+// in lockstep, so one that is done simply stops changing while the others catch up.
+template <std::size_t Rows, std::size_t Cols, typename V>
+inline V count_components_lanes(std::array<V, consts::NUM_PLANES>& m) noexcept {
+    V combos = {};
+    std::array<V, consts::NUM_PLANES> region;
+    for(;;) {
+        V left = {};
+        for(int k = 0; k < consts::NUM_PLANES; k++) {
+            region[k] = m[k] & (~m[k] + 1);
+            left |= m[k];
+        }
+        if(!any_lane(left))
+            return combos;
+        V changed;
+        do {
+            changed = V {};
+            for(int k = 0; k < consts::NUM_PLANES; k++) {
+                V grown = (region[k] | neighbors<Rows, Cols>(region[k])) & m[k];
+                changed |= grown ^ region[k];
+                region[k] = grown;
+            }
+        } while(any_lane(changed));
+        for(int k = 0; k < consts::NUM_PLANES; k++) {
+            m[k] &= ~region[k];
+            combos += V(region[k] != 0) & 1;
+        }
+    }
+}
+
+// One sand step per iteration: every orb with an empty cell right below it (in the same column) falls
+// by one. Only lanes set in active move.
+template <std::size_t Rows, std::size_t Cols, typename V>
+inline void skyfall_lanes(std::array<V, consts::NUM_PLANES>& planes, V active) noexcept {
+    using L = Layout<Rows, Cols>;
+    const int EMPTY = enum_value(Orb::empty);
+    for(;;) {
+        V empty = planes[EMPTY];
+        V falls = ~empty & (empty >> 1) & ~L::BOTTOM_ROW & L::BOARD_MASK & active;
+        if(!any_lane(falls))
+            return;
+        for(int k = 0; k < consts::NUM_PLANES; k++) {
+            if(k == EMPTY)
+                continue;
+            V moving = planes[k] & falls;
+            planes[k] ^= moving | (moving << 1);
+        }
+        planes[EMPTY] ^= falls | (falls << 1);
+    }
+}
+
+} // namespace detail
+
+// Same as score() on every board, out[i] for in[i].
+template <std::size_t Rows, std::size_t Cols>
+void score_batch(const BitBoardT<Rows, Cols>* in, int* out, std::size_t n) noexcept {
+    using M = MaskT<Rows, Cols>;
+    using V = typename detail::Lanes<M>::type;
+    const std::size_t LANES = detail::Lanes<M>::SIZE;
+    const int EMPTY = detail::enum_value(Orb::empty);
+
+    for(std::size_t first = 0; first < n; first += LANES) {
+        std::size_t count = std::min(LANES, n - first);
+        // Transpose into one vector per plane. Unused lanes hold an empty board, which scores 0.
+        std::array<V, consts::NUM_PLANES> planes;
+        for(int k = 0; k < consts::NUM_PLANES; k++) {
+            for(std::size_t i = 0; i < LANES; i++) {
+                planes[k][i] = i < count ? in[first + i].planes[k] : (k == EMPTY ? Layout<Rows, Cols>::BOARD_MASK : 0);
+            }
+        }
+
+        V total = {};
+        V active = ~V {};
+        while(detail::any_lane(active)) {
+            V cleared = {};
+            std::array<V, consts::NUM_PLANES> matched;
+            for(int k = 0; k < consts::NUM_PLANES; k++) {
+                matched[k] = k == EMPTY ? V {} : detail::match_mask<Rows, Cols>(planes[k]) & active;
+                planes[k] &= ~matched[k];
+                cleared |= matched[k];
+            }
+            planes[EMPTY] |= cleared;
+            total += detail::count_components_lanes<Rows, Cols>(matched);
+            // Like score(), a board that cleared nothing is done.
+            active = V(cleared != 0);
+            detail::skyfall_lanes<Rows, Cols>(planes, active);
+        }
+
+        for(std::size_t i = 0; i < count; i++) {
+            out[first + i] = int(total[i]);
+        }
+    }
+}
+
+template <std::size_t Rows, std::size_t Cols>
+void score_batch(const BoardT<Rows, Cols>* in, int* out, std::size_t n) {
+    std::array<BitBoardT<Rows, Cols>, detail::Lanes<MaskT<Rows, Cols>>::SIZE> bits;
+    for(std::size_t first = 0; first < n; first += bits.size()) {
+        std::size_t count = std::min(bits.size(), n - first);
+        for(std::size_t i = 0; i < count; i++) {
+            bits[i] = to_bitboard(in[first + i]);
+        }
+        score_batch(bits.data(), out + first, count);
+    }
+}
+
+} // namespace pad
@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "zobrist.hpp"
+
+/**
+ * A fixed-size, lock-free cache from a board hash to its score.
+ *
+ * Scoring runs the whole cascade, which makes it the most expensive part of a DFS node, and the
+ * same boards keep coming back: from every starting point, from every worker, and whenever the
+ * cursor walks through orbs of its own color. The score only depends on the board, not on where
+ * the cursor is, so it is keyed by the board hash alone.
+ *
+ * Each slot is a single atomic word: [ tag : 56 | score + 1 : 8 ], where a 0 score byte is an empty
+ * slot. Like the TranspositionTable, the table is direct-mapped and a colliding board simply evicts
+ * the old one. The memory cap is rounded down to a power of two of slots.
+ */
+
+namespace pad {
+
+class ScoreCache {
+public:
+    // By default 2^16 slots, i.e. 512KB, which stays in L2 next to the transposition table.
+    static const std::size_t DEFAULT_BYTES = std::size_t(1) << 19;
+
+    explicit ScoreCache(std::size_t max_bytes = DEFAULT_BYTES)
+        : size_log2(floor_log2(std::max<std::size_t>(max_bytes / sizeof(std::uint64_t), 1))),
+          slots(new std::atomic<std::uint64_t>[std::size_t(1) << size_log2]),
+          mask((std::uint64_t(1) << size_log2) - 1)
+    {
+        clear();
+    }
+
+    // Returns true and sets score if the board is in the cache.
+    bool lookup(Hash key, int& score) noexcept {
+        std::uint64_t cur = slots[key & mask].load(std::memory_order_relaxed);
+        Counters& c = counters[shard()];
+        if((cur & SCORE_MASK) && (cur & ~SCORE_MASK) == (key & ~SCORE_MASK)) {
+            score = int(cur & SCORE_MASK) - 1;
+            c.hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        c.misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void insert(Hash key, int score) noexcept {
+        slots[key & mask].store((key & ~SCORE_MASK) | std::uint64_t(score + 1), std::memory_order_relaxed);
+    }
+
+    void clear() noexcept {
+        for(std::size_t i = 0; i <= mask; i++)
+            slots[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t size() const noexcept {
+        return mask + 1;
+    }
+
+    std::size_t bytes() const noexcept {
+        return size() * sizeof(std::uint64_t);
+    }
+
+    std::uint64_t hits() const noexcept {
+        std::uint64_t n = 0;
+        for(const Counters& c : counters)
+            n += c.hits.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    std::uint64_t misses() const noexcept {
+        std::uint64_t n = 0;
+        for(const Counters& c : counters)
+            n += c.misses.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    void reset_counters() noexcept {
+        for(Counters& c : counters) {
+            c.hits.store(0, std::memory_order_relaxed);
+            c.misses.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static const std::uint64_t SCORE_MASK = 0xff;
+    static const int NUM_SHARDS = 16;
+
+    // Every thread bumps its own shard, so the counters don't bounce a cache line between cores.
+    struct alignas(64) Counters {
+        std::atomic<std::uint64_t> hits {0};
+        std::atomic<std::uint64_t> misses {0};
+    };
+
+    static int floor_log2(std::size_t n) noexcept {
+        int log2 = 0;
+        while(n >>= 1)
+            log2++;
+        return log2;
+    }
+
+    static int shard() noexcept {
+        static thread_local int mine = std::hash<std::thread::id>()(std::this_thread::get_id()) % NUM_SHARDS;
+        return mine;
+    }
+
+    int size_log2;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+    std::uint64_t mask;
+    std::array<Counters, NUM_SHARDS> counters;
+};
+
+} // namespace pad
@@ -0,0 +1,94 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <map>
+#include <sstream>
+#include <string>
+#include "detail.hpp"
+#include "state.hpp"
+#include "bitboard.hpp"
+#include "score.hpp"
+
+/**
+ * What score() cleared, combo by combo, in the order it cleared them. Pass one to score() and it is
+ * filled through the same visitor hook the weighted policies use, so the plain score() does not pay
+ * for any of it.
+ *
+ * Every combo clears at least MIN_ORB_COMBO orbs and skyfall brings no new ones, so a whole cascade
+ * has at most MAX_COMBOS combos and a fixed array holds them without allocating.
+ */
+
+namespace pad {
+
+namespace consts {
+
+static const std::map<Shape, const char*> SHAPE_TO_STRING = {
+    {Shape::plain,   "plain"},
+    {Shape::tpa,     "tpa"},
+    {Shape::row,     "row"},
+    {Shape::cross,   "cross"},
+    {Shape::l_shape, "L"},
+};
+
+} // namespace consts
+
+template <std::size_t Rows, std::size_t Cols>
+class ScoreDetailT {
+public:
+    using const_iterator = typename std::array<Combo, Dims<Rows, Cols>::MAX_COMBOS>::const_iterator;
+
+    // The visitor hook, see score().
+    void operator()(const Combo& c) noexcept {
+        combos[num_combos++] = c;
+    }
+    int size() const noexcept {
+        return num_combos;
+    }
+    const Combo& operator[](int i) const noexcept {
+        return combos[i];
+    }
+    const_iterator begin() const noexcept {
+        return combos.begin();
+    }
+    const_iterator end() const noexcept {
+        return combos.begin() + num_combos;
+    }
+    // The number of waves that cleared something, i.e. 1 without any cascade.
+    int waves() const noexcept {
+        return num_combos ? combos[num_combos - 1].wave + 1 : 0;
+    }
+    void clear() noexcept {
+        num_combos = 0;
+    }
+    // One line per combo, e.g. "wave 0: 4 r (tpa)".
+    std::string to_string() const {
+        std::ostringstream ss;
+        for(const Combo& c : *this) {
+            ss << "wave " << c.wave << ": " << c.count << " " << detail::get_value(consts::ORB_TO_CHAR, c.orb)
+               << " (" << detail::get_value(consts::SHAPE_TO_STRING, c.shape) << ")\n";
+        }
+        return ss.str();
+    }
+private:
+    std::array<Combo, Dims<Rows, Cols>::MAX_COMBOS> combos;
+    int num_combos = 0;
+};
+
+using ScoreDetail = ScoreDetailT<consts::NUM_ROWS, consts::NUM_COLS>;
+
+// Same as score(b), and also fills report (which is cleared first).
+template <std::size_t Rows, std::size_t Cols>
+int score(BitBoardT<Rows, Cols>& bb, ScoreDetailT<Rows, Cols>& report) noexcept {
+    report.clear();
+    return score<Rows, Cols, ScoreDetailT<Rows, Cols>&>(bb, report);
+}
+
+template <std::size_t Rows, std::size_t Cols>
+int score(BoardT<Rows, Cols>& b, ScoreDetailT<Rows, Cols>& report) {
+    auto bb = to_bitboard(b);
+    int s = score(bb, report);
+    b = to_board(bb);
+    return s;
+}
+
+} // namespace pad
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include "detail.hpp"
+#include "state.hpp"
+#include "bitboard.hpp"
+#include "score.hpp"
+#include "score_detail.hpp"
+
+/**
+ * Scoring policies: what the search maximizes, for every combo count, instead of just the combo count.
+ *
+ * A policy is a plain type with
+ *   - static constexpr bool COUNT_ONLY: whether only the combo count matters. Then a path only ever
+ *     competes on length, which lets the search stop early and prune against the incumbent.
+ *   - double evaluate(BitBoardT<Rows, Cols>& bb, int& combos) const: runs the cascade on bb (same
+ *     contract as score()), sets combos and returns the value of the board.
+ * It is a template parameter of the search, so evaluate() is inlined into the DFS: no virtual calls.
+ *
+ * For every combo count, find_combos keeps the path with the highest value, then the shortest one.
+ */
+
+namespace pad {
+
+// The default: the value is the combo count, so every path competes on length alone.
+struct ComboCount {
+    static constexpr bool COUNT_ONLY = true;
+
+    template <std::size_t Rows, std::size_t Cols>
+    double evaluate(BitBoardT<Rows, Cols>& bb, int& combos) const noexcept {
+        combos = score(bb);
+        return combos;
+    }
+};
+
+/**
+ * A damage estimate, following the in-game formula:
+ *   - every combo hits for color_weight[color] (the team's attack in that color, 0 to ignore it),
+ *     plus extra_orb_bonus of that for every orb past MIN_ORB_COMBO,
+ *   - a TPA multiplies its own combo by tpa_multiplier,
+ *   - the sum is multiplied by 1 + combo_bonus * (combos - 1),
+ *   - then by 1 + row_bonus for every row,
+ *   - and by cross_multiplier / l_multiplier for every cross / L (leader skills).
+ * The defaults are the in-game values without any awakenings or leader skills.
+ */
+struct WeightedScore {
+    static constexpr bool COUNT_ONLY = false;
+
+    std::array<double, consts::NUM_PLANES - 1> color_weight {{1, 1, 1, 1, 1, 1}};
+    double extra_orb_bonus = 0.25;
+    double tpa_multiplier = 1.0;
+    double combo_bonus = 0.25;
+    double row_bonus = 0.0;
+    double cross_multiplier = 1.0;
+    double l_multiplier = 1.0;
+
+    template <std::size_t Rows, std::size_t Cols>
+    double evaluate(BitBoardT<Rows, Cols>& bb, int& combos) const noexcept {
+        ScoreDetailT<Rows, Cols> report;
+        combos = score(bb, report);
+        return value(report);
+    }
+
+    // The same damage for a board that was already scored, e.g. to explain a solution.
+    template <std::size_t Rows, std::size_t Cols>
+    double value(const ScoreDetailT<Rows, Cols>& report) const noexcept {
+        if(!report.size())
+            return 0;
+        double base = 0;
+        double multiplier = 1;
+        int rows = 0;
+        for(const Combo& c : report) {
+            double damage = color_weight[detail::enum_value(c.orb)] * (1 + extra_orb_bonus * (c.count - consts::MIN_ORB_COMBO));
+            switch(c.shape) {
+                case Shape::tpa: damage *= tpa_multiplier; break;
+                case Shape::row: rows++; break;
+                case Shape::cross: multiplier *= cross_multiplier; break;
+                case Shape::l_shape: multiplier *= l_multiplier; break;
+                case Shape::plain: break;
+            }
+            base += damage;
+        }
+        return base * (1 + combo_bonus * (report.size() - 1)) * (1 + row_bonus * rows) * multiplier;
+    }
+};
+
+} // namespace pad
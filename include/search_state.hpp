@@ -0,0 +1,125 @@
+#pragma once
+
+#include "detail.hpp"
+#include "state.hpp"
+#include "action.hpp"
+#include "bitboard.hpp"
+#include "score.hpp"
+#include "zobrist.hpp"
+
+/**
+ * The mutable state the search walks: a single board plus the cursor holding the orb.
+ * Instead of copying the board for every child (see populate()), a move is applied in place
+ * and undone on the way back up, so a DFS touches exactly one board and never allocates per node.
+ *
+ * We keep both representations in sync: the array board answers "which orb is at this cell"
+ * in O(1) for the swap, and the bitboard is what gets scored. The Zobrist hash of the board
+ * is updated along with every swap.
+ *
+ * So are the matches of the first wave. A swap only changes the planes of the two orbs it swaps,
+ * so only those two are matched again, and most of the boards the DFS walks through turn out to
+ * clear nothing: those score 0 without running the cascade at all.
+ */
+
+namespace pad {
+
+template <std::size_t Rows, std::size_t Cols>
+struct SearchStateT {
+    BoardT<Rows, Cols> board;
+    BitBoardT<Rows, Cols> bits;
+    Coord cursor;
+    // Hash of the board only, see state_key() for the hash of the search node.
+    Hash hash;
+    // detail::match_mask() of every plane, 0 for the empty one.
+    std::array<MaskT<Rows, Cols>, consts::NUM_PLANES> matched;
+};
+
+using SearchState = SearchStateT<consts::NUM_ROWS, consts::NUM_COLS>;
+
+template <std::size_t Rows, std::size_t Cols>
+struct board_dims<SearchStateT<Rows, Cols>> : Dims<Rows, Cols> {};
+
+template <std::size_t Rows, std::size_t Cols>
+SearchStateT<Rows, Cols> make_search_state(const BoardT<Rows, Cols>& b, const Coord& cursor) noexcept {
+    SearchStateT<Rows, Cols> s { b, to_bitboard(b), cursor, board_hash(b), {} };
+    for(int k = 0; k < consts::NUM_PLANES; k++) {
+        if(Orb(k) != Orb::empty)
+            s.matched[k] = detail::match_mask<Rows, Cols>(s.bits.planes[k]);
+    }
+    return s;
+}
+
+// Whether the board clears anything at all.
+template <std::size_t Rows, std::size_t Cols>
+inline bool has_matches(const SearchStateT<Rows, Cols>& s) noexcept {
+    MaskT<Rows, Cols> any = 0;
+    for(auto m : s.matched)
+        any |= m;
+    return any != 0;
+}
+
+// Identifies a search node: the board plus where the cursor is.
+template <std::size_t Rows, std::size_t Cols>
+inline Hash state_key(const SearchStateT<Rows, Cols>& s) noexcept {
+    return s.hash ^ cursor_key<Rows, Cols>(s.cursor);
+}
+
+// The action that takes the cursor back to where it came from.
+inline Action opposite(Action a) noexcept {
+    return Action(detail::enum_value(a) ^ 0x1);
+}
+
+namespace detail {
+template <std::size_t Rows, std::size_t Cols>
+inline void swap_cells(SearchStateT<Rows, Cols>& s, const Coord& a, const Coord& b) noexcept {
+    using L = Layout<Rows, Cols>;
+    Orb& oa = s.board[a.first][a.second];
+    Orb& ob = s.board[b.first][b.second];
+    if(oa != ob) {
+        auto both = L::cell_bit(a) | L::cell_bit(b);
+        s.bits[oa] ^= both;
+        s.bits[ob] ^= both;
+        s.hash ^= orb_key<Rows, Cols>(a, oa) ^ orb_key<Rows, Cols>(a, ob) ^
+                  orb_key<Rows, Cols>(b, ob) ^ orb_key<Rows, Cols>(b, oa);
+        std::swap(oa, ob);
+        s.matched[enum_value(oa)] = match_mask<Rows, Cols>(s.bits[oa]);
+        s.matched[enum_value(ob)] = match_mask<Rows, Cols>(s.bits[ob]);
+    }
+}
+} // namespace detail
+
+// Assumption: the move is valid, i.e. check_move(change_coords(s.cursor, a)) == 0.
+template <std::size_t Rows, std::size_t Cols>
+inline void apply_move(SearchStateT<Rows, Cols>& s, Action a) noexcept {
+    Coord next = change_coords(s.cursor, a);
+    detail::swap_cells(s, s.cursor, next);
+    s.cursor = next;
+}
+
+// Undoes apply_move(s, a). Swapping is its own inverse, so we just walk back.
+template <std::size_t Rows, std::size_t Cols>
+inline void undo_move(SearchStateT<Rows, Cols>& s, Action a) noexcept {
+    apply_move(s, opposite(a));
+}
+
+// Unlike score(Board&), this leaves the state untouched: the cascade runs on a copy of the
+// bitboard, which is only a handful of words. The first wave is already known.
+template <std::size_t Rows, std::size_t Cols>
+inline int score(const SearchStateT<Rows, Cols>& s) noexcept {
+    if(!has_matches(s))
+        return 0;
+    auto bb = s.bits;
+    return score_from_matches(bb, s.matched);
+}
+
+// Same as score(s), and also counts the waves that cleared something.
+template <std::size_t Rows, std::size_t Cols>
+inline int score(const SearchStateT<Rows, Cols>& s, int& waves) noexcept {
+    waves = 0;
+    if(!has_matches(s))
+        return 0;
+    auto bb = s.bits;
+    return score_from_matches(bb, s.matched, waves);
+}
+
+} // namespace pad
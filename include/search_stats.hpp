@@ -0,0 +1,112 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "state.hpp"
+
+/**
+ * What a find_combos call spent its time on, for capacity planning and for finding the boards that are
+ * expensive to solve.
+ *
+ * Every worker counts into its own ThreadStats (it lives in the worker's SearchContext), and they are
+ * added up once the search is done, so counting never touches shared memory. Without a SearchStats
+ * the search is instantiated with NoStats instead, whose hooks are empty and compile to nothing.
+ */
+
+namespace pad {
+namespace dfs {
+
+using Clock = std::chrono::steady_clock;
+
+// The cascade histogram has a bucket for every number of waves up to this; longer ones go in the last.
+static const int MAX_WAVES = 15;
+
+struct SearchStats {
+    // Every node the DFS entered, including the ones the transposition table or a prune cut right away.
+    long nodes = 0;
+    // Boards that were actually scored, i.e. not the ones that reused their parent's evaluation.
+    long scored = 0;
+    // Children skipped for undoing the previous move.
+    long pruned_opposite = 0;
+    // How many waves cleared something, over the scored boards that were simulated (a score cache hit
+    // doesn't know): [0] is a board that clears nothing, [1] one without a cascade, and so on.
+    std::array<long, MAX_WAVES + 1> cascade_waves {};
+    // Per worker, the calling thread first.
+    std::vector<long> thread_nodes;
+    // Per worker, the time it spent waiting: to be picked up by the pool, and for the others to finish.
+    std::vector<Clock::duration> thread_idle;
+    // Per starting point (in order), the time spent in its subtrees, summed over the workers.
+    std::vector<Coord> roots;
+    std::vector<Clock::duration> root_time;
+    Clock::duration wall {0};
+
+    std::string to_string() const {
+        using std::chrono::duration;
+        std::ostringstream ss;
+        ss << "nodes: " << nodes << ", scored: " << scored << ", pruned (opposite): " << pruned_opposite
+           << ", wall: " << duration<double, std::milli>(wall).count() << "ms\n";
+        ss << "cascade waves:";
+        for(long n : cascade_waves)
+            ss << " " << n;
+        ss << "\n";
+        for(size_t i = 0; i < thread_nodes.size(); i++) {
+            ss << "worker " << i << ": " << thread_nodes[i] << " nodes, idle "
+               << duration<double, std::milli>(thread_idle[i]).count() << "ms\n";
+        }
+        for(size_t i = 0; i < roots.size(); i++) {
+            ss << "(" << roots[i].first << ", " << roots[i].second << "): "
+               << duration<double, std::milli>(root_time[i]).count() << "ms\n";
+        }
+        return ss.str();
+    }
+};
+
+// The hooks the DFS calls, for when nobody asked for stats.
+struct NoStats {
+    static constexpr bool ENABLED = false;
+    void scored() noexcept {}
+    void pruned_opposite() noexcept {}
+    void cascade(int) noexcept {}
+};
+
+// One worker's counters.
+struct ThreadStats {
+    static constexpr bool ENABLED = true;
+    void scored() noexcept {
+        num_scored++;
+    }
+    void pruned_opposite() noexcept {
+        num_pruned_opposite++;
+    }
+    void cascade(int waves) noexcept {
+        cascade_waves[std::min(waves, MAX_WAVES)]++;
+    }
+    void add_root_time(std::size_t root, Clock::duration d) {
+        if(root_time.size() <= root)
+            root_time.resize(root + 1, Clock::duration(0));
+        root_time[root] += d;
+    }
+
+    // Adds everything but the per-thread numbers, which the caller knows how to file.
+    void merge_into(SearchStats& stats) const {
+        stats.scored += num_scored;
+        stats.pruned_opposite += num_pruned_opposite;
+        for(int k = 0; k <= MAX_WAVES; k++)
+            stats.cascade_waves[k] += cascade_waves[k];
+        if(stats.root_time.size() < root_time.size())
+            stats.root_time.resize(root_time.size(), Clock::duration(0));
+        for(std::size_t i = 0; i < root_time.size(); i++)
+            stats.root_time[i] += root_time[i];
+    }
+
+    long num_scored = 0;
+    long num_pruned_opposite = 0;
+    std::array<long, MAX_WAVES + 1> cascade_waves {};
+    std::vector<Clock::duration> root_time;
+};
+
+} // namespace dfs
+} // namespace pad
@@ -0,0 +1,181 @@
+#pragma once
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Just enough of the sockets API for padsolved and padload: listening on and connecting to a Unix
+ * domain socket or a port on the loopback interface, and line-based I/O on the connection.
+ *
+ * An address is either a path (Unix domain socket) or a port number (127.0.0.1 only, the service is
+ * meant for this machine). Failures throw std::runtime_error with what errno said.
+ */
+
+namespace pad {
+namespace net {
+
+namespace detail {
+
+[[noreturn]] inline void fail(const std::string& what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+inline bool is_port(const std::string& address) {
+    return !address.empty() && address.find_first_not_of("0123456789") == std::string::npos;
+}
+
+inline sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("socket path too long: " + path);
+    std::strcpy(addr.sun_path, path.c_str());
+    return addr;
+}
+
+inline sockaddr_in loopback_address(const std::string& port) {
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(std::stoi(port));
+    return addr;
+}
+
+// Requests and answers are single short lines, so don't let Nagle hold them back.
+inline void no_delay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+} // namespace detail
+
+// Returns the listening socket. A stale Unix socket file from an earlier run is replaced.
+inline int listen_on(const std::string& address, int backlog = 128) {
+    int fd;
+    if(detail::is_port(address)) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0)
+            detail::fail("socket");
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = detail::loopback_address(address);
+        if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+            detail::fail("bind " + address);
+    } else {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0)
+            detail::fail("socket");
+        sockaddr_un addr = detail::unix_address(address);
+        unlink(address.c_str());
+        if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+            detail::fail("bind " + address);
+    }
+    if(listen(fd, backlog) < 0)
+        detail::fail("listen");
+    return fd;
+}
+
+inline int accept_from(int listen_fd) {
+    int fd;
+    do {
+        fd = accept(listen_fd, nullptr, nullptr);
+    } while(fd < 0 && errno == EINTR);
+    if(fd < 0)
+        detail::fail("accept");
+    detail::no_delay(fd);
+    return fd;
+}
+
+inline int connect_to(const std::string& address) {
+    int fd;
+    int ok;
+    if(detail::is_port(address)) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = detail::loopback_address(address);
+        ok = fd >= 0 ? connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) : -1;
+    } else {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = detail::unix_address(address);
+        ok = fd >= 0 ? connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) : -1;
+    }
+    if(ok < 0) {
+        if(fd >= 0)
+            close(fd);
+        detail::fail("connect " + address);
+    }
+    detail::no_delay(fd);
+    return fd;
+}
+
+// Writes all of s, returns false once the other end is gone.
+inline bool write_all(int fd, const std::string& s) {
+    size_t done = 0;
+    while(done < s.size()) {
+        ssize_t n = send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+// Reads a connection line by line. With a max_line, a line longer than that ends the stream
+// (with too_long() set) instead of growing the buffer for as long as the other end keeps sending.
+class LineReader {
+public:
+    explicit LineReader(int fd, size_t max_line = 0) : fd(fd), max_line(max_line) {}
+
+    // The next line without its newline, false at the end of the stream.
+    bool next(std::string& line) {
+        if(too_long_)
+            return false;
+        for(;;) {
+            size_t nl = buffer.find('\n', start);
+            size_t length = (nl == std::string::npos ? buffer.size() : nl) - start;
+            if(max_line && length > max_line) {
+                too_long_ = true;
+                return false;
+            }
+            if(nl != std::string::npos) {
+                line.assign(buffer, start, nl - start);
+                start = nl + 1;
+                return true;
+            }
+            buffer.erase(0, start);
+            start = 0;
+            char chunk[4096];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n <= 0) {
+                // A last line without a newline still counts.
+                line.swap(buffer);
+                buffer.clear();
+                return !line.empty();
+            }
+            buffer.append(chunk, n);
+        }
+    }
+
+    // Whether the stream ended at a line longer than max_line.
+    bool too_long() const {
+        return too_long_;
+    }
+private:
+    int fd;
+    size_t max_line;
+    std::string buffer;
+    size_t start = 0;
+    bool too_long_ = false;
+};
+
+} // namespace net
+} // namespace pad
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "thread_pool.hpp"
+#include "score_cache.hpp"
+#include "state.hpp"
+#include "algorithm.hpp"
+#include "beam.hpp"
+
+/**
+ * A long-lived solver: owns the worker threads so that repeated find_combos calls don't
+ * spawn and join a pool every time. Meant to be created once per process (or per server)
+ * and reused for every board.
+ *
+ * Every call still uses the calling thread as one of the workers, so a Solver with N threads
+ * searches with N + 1.
+ *
+ * The solver also keeps a ScoreCache of at most score_cache_bytes (none if 0) across calls, and the
+ * transposition tables of earlier calls: a call borrows one and only starts a new epoch on it, instead
+ * of allocating and clearing a table of its own. Calls from several threads at once each get their own.
+ */
+
+namespace pad {
+
+// Where the pool's workers are allowed to run.
+enum class AffinityPolicy {
+    none,   // leave it to the OS scheduler
+    pinned, // worker i only runs on cpu (i mod number of cpus)
+};
+
+class Solver {
+public:
+    explicit Solver(size_t num_threads = default_num_threads(), AffinityPolicy affinity = AffinityPolicy::none,
+                    size_t score_cache_bytes = ScoreCache::DEFAULT_BYTES)
+        : pool(new ThreadPool(num_threads)),
+          cache(score_cache_bytes ? new ScoreCache(score_cache_bytes) : nullptr)
+    {
+        if(affinity == AffinityPolicy::pinned) {
+            unsigned num_cpus = std::max(1u, std::thread::hardware_concurrency());
+            for(size_t i = 0; i < pool->size(); i++) {
+                pool->pin(i, i % num_cpus);
+            }
+        }
+    }
+
+    // One less than the hardware threads, since the caller works too.
+    static size_t default_num_threads() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 1 ? n - 1 : 1;
+    }
+
+    size_t num_threads() const {
+        return pool->size();
+    }
+
+    ThreadPool& thread_pool() {
+        return *pool;
+    }
+
+    // nullptr if the solver was made without one.
+    ScoreCache* score_cache() {
+        return cache.get();
+    }
+
+    // The solver's pool, cache and a transposition table of its own go in place of whatever opts has.
+    template <std::size_t Rows, std::size_t Cols, typename Policy = ComboCount>
+    dfs::SolutionMap find_combos(const BoardT<Rows, Cols>& b, dfs::SearchOptions opts, const Policy& policy = Policy()) {
+        TableLease tt(*this);
+        lend(opts, tt);
+        return dfs::find_combos(b, opts, policy);
+    }
+
+    template <std::size_t Rows, std::size_t Cols>
+    dfs::SolutionMap find_combos(const BoardT<Rows, Cols>& b, int max_depth = dfs::MAX_DEPTH, bool smart_populate = false,
+                                 int num_to_populate = dfs::NUM_TO_POPULATE) {
+        dfs::SearchOptions opts;
+        opts.max_depth = max_depth;
+        opts.smart_populate = smart_populate;
+        opts.num_to_populate = num_to_populate;
+        return find_combos(b, opts);
+    }
+
+    template <std::size_t Rows, std::size_t Cols, typename Policy = ComboCount>
+    dfs::SolutionMap find_combos_until(const BoardT<Rows, Cols>& b, dfs::Clock::time_point deadline, dfs::SearchOptions opts,
+                                       const Policy& policy = Policy()) {
+        TableLease tt(*this);
+        lend(opts, tt);
+        return dfs::find_combos_until(b, deadline, opts, policy);
+    }
+
+    template <std::size_t Rows, std::size_t Cols>
+    dfs::SolutionMap find_combos_until(const BoardT<Rows, Cols>& b, dfs::Clock::time_point deadline, int max_depth = dfs::MAX_DEPTH,
+                                       bool smart_populate = false, int num_to_populate = dfs::NUM_TO_POPULATE) {
+        dfs::SearchOptions opts;
+        opts.max_depth = max_depth;
+        opts.smart_populate = smart_populate;
+        opts.num_to_populate = num_to_populate;
+        return find_combos_until(b, deadline, opts);
+    }
+
+    template <std::size_t Rows, std::size_t Cols>
+    dfs::SolutionMap beam_find_combos(const BoardT<Rows, Cols>& b, int max_depth = beam::MAX_DEPTH, bool smart_populate = false,
+                                      int num_to_populate = dfs::NUM_TO_POPULATE, int beam_width = beam::BEAM_WIDTH,
+                                      dfs::Clock::time_point deadline = dfs::Clock::time_point::max()) {
+        return beam::find_combos(b, max_depth, smart_populate, num_to_populate, beam_width, pool.get(), deadline);
+    }
+
+private:
+    // A transposition table borrowed for one call, and given back at the end of it.
+    class TableLease {
+    public:
+        explicit TableLease(Solver& solver) : solver(solver) {
+            std::lock_guard<std::mutex> lock(solver.tables_mutex);
+            if(solver.tables.empty()) {
+                table.reset(new TranspositionTable());
+            } else {
+                table = std::move(solver.tables.back());
+                solver.tables.pop_back();
+            }
+        }
+        ~TableLease() {
+            std::lock_guard<std::mutex> lock(solver.tables_mutex);
+            solver.tables.push_back(std::move(table));
+        }
+        TranspositionTable* get() {
+            return table.get();
+        }
+    private:
+        Solver& solver;
+        std::unique_ptr<TranspositionTable> table;
+    };
+
+    void lend(dfs::SearchOptions& opts, TableLease& tt) {
+        opts.pool = pool.get();
+        opts.cache = cache.get();
+        opts.tt = tt.get();
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    std::unique_ptr<ScoreCache> cache;
+    // The tables no call is using right now.
+    std::vector<std::unique_ptr<TranspositionTable>> tables;
+    std::mutex tables_mutex;
+};
+
+} // namespace pad
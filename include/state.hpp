@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <utility>
 #include <array>
 #include <map>
@@ -38,7 +39,8 @@ enum class Orb : std::uint8_t {
 
 namespace consts {
 
-// A board is always static 5x6:
+// The usual board is 5x6, and everything defaults to it. Dungeons also use 4x5 and 6x7 boards,
+// for those see Dims below.
 static const int NUM_ROWS = 5; 
 static const int NUM_COLS = 6;
 static const int NUM_ORBS = NUM_ROWS * NUM_COLS;
@@ -87,7 +89,32 @@ static const std::map<Action, char> ACTION_TO_CHAR = {
 
 } // namespace consts
 
-using Board = std::array< std::array<Orb, consts::NUM_COLS>, consts::NUM_ROWS >;
+/**
+ * The board dimensions are compile-time constants, so every size gets its own fully unrolled code.
+ * Everything that depends on the size is templated on <Rows, Cols> and reads its constants from Dims,
+ * which mirrors the consts above for the default 5x6 board.
+ */
+template <std::size_t Rows, std::size_t Cols>
+struct Dims {
+    static constexpr int NUM_ROWS = Rows;
+    static constexpr int NUM_COLS = Cols;
+    static constexpr int NUM_ORBS = NUM_ROWS * NUM_COLS;
+    static constexpr int MAX_COMBOS = NUM_ORBS / consts::MIN_ORB_COMBO;
+};
+
+template <std::size_t Rows, std::size_t Cols>
+using BoardT = std::array< std::array<Orb, Cols>, Rows >;
+
+using Board = BoardT<consts::NUM_ROWS, consts::NUM_COLS>;
+using SmallBoard = BoardT<4, 5>;
+using LargeBoard = BoardT<6, 7>;
+
+// Recovers the dimensions of any board representation, e.g. board_dims<BitBoard>::NUM_ROWS.
+template <typename B>
+struct board_dims;
+
+template <std::size_t Rows, std::size_t Cols>
+struct board_dims<BoardT<Rows, Cols>> : Dims<Rows, Cols> {};
 
 // A player's cursor will be a 2d tuple of <row, col>
 using Coord = std::pair<int, int>;
@@ -1,11 +1,17 @@
 /**
  * Never make your own threadpool if someone else already did it for you:
  * https://github.com/progschj/ThreadPool/blob/master/ThreadPool.h
+ *
+ * ...unless the solver wants to schedule tasks that only take a few microseconds each.
+ * The interface is still the one above, but underneath:
+ * - every worker has its own bounded lock-free queue, and steals from the others when it runs dry,
+ * - tasks are stored inline in the queue slots (no std::function, no shared_ptr per task),
+ * - idle workers spin for a while before parking on a condition variable.
  */
 
 #pragma once
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -13,84 +19,378 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace thread_pool_detail {
+
+// A move-only void() callable that keeps small callables in an inline buffer.
+// Anything bigger than the buffer is moved to the heap, which is the only case that allocates.
+class Task {
+public:
+    static const size_t CAPACITY = 48;
+
+    Task() noexcept : ops(nullptr) {}
+
+    template<class F, class D = typename std::decay<F>::type,
+             class = typename std::enable_if<!std::is_same<D, Task>::value>::type>
+    Task(F&& f) {
+        if(sizeof(D) <= CAPACITY && alignof(D) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<D>::value) {
+            new (buf) D(std::forward<F>(f));
+            ops = &inline_ops<D>;
+        }
+        else {
+            *reinterpret_cast<D**>(buf) = new D(std::forward<F>(f));
+            ops = &heap_ops<D>;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops(other.ops) {
+        if(ops) {
+            ops->relocate(other.buf, buf);
+            other.ops = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if(this != &other) {
+            reset();
+            ops = other.ops;
+            if(ops) {
+                ops->relocate(other.buf, buf);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        reset();
+    }
+
+    void operator()() {
+        ops->invoke(buf);
+    }
+
+    explicit operator bool() const noexcept {
+        return ops != nullptr;
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        // move-construct into to, and destroy from
+        void (*relocate)(void* from, void* to) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<class D>
+    static void inline_invoke(void* p) { (*static_cast<D*>(p))(); }
+    template<class D>
+    static void inline_relocate(void* from, void* to) noexcept {
+        new (to) D(std::move(*static_cast<D*>(from)));
+        static_cast<D*>(from)->~D();
+    }
+    template<class D>
+    static void inline_destroy(void* p) noexcept { static_cast<D*>(p)->~D(); }
+
+    template<class D>
+    static void heap_invoke(void* p) { (**static_cast<D**>(p))(); }
+    static void heap_relocate(void* from, void* to) noexcept {
+        *static_cast<void**>(to) = *static_cast<void**>(from);
+    }
+    template<class D>
+    static void heap_destroy(void* p) noexcept { delete *static_cast<D**>(p); }
+
+    template<class D>
+    static constexpr Ops inline_ops = { &inline_invoke<D>, &inline_relocate<D>, &inline_destroy<D> };
+    template<class D>
+    static constexpr Ops heap_ops = { &heap_invoke<D>, &heap_relocate, &heap_destroy<D> };
+
+    void reset() noexcept {
+        if(ops) {
+            ops->destroy(buf);
+            ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char buf[CAPACITY];
+    const Ops* ops;
+};
+
+// Dmitry Vyukov's bounded multi-producer multi-consumer queue: every slot has a sequence number
+// that says whether it is ready to be written or read, so a push or pop is a single CAS on the
+// position plus a store to the slot, and slots hold the tasks themselves.
+template<class T, size_t N>
+class BoundedQueue {
+    static_assert((N & (N - 1)) == 0, "BoundedQueue size has to be a power of 2");
+public:
+    BoundedQueue() : enqueue_pos(0), dequeue_pos(0) {
+        for(size_t i = 0; i < N; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~BoundedQueue() {
+        T t;
+        while(try_pop(t))
+            ;
+    }
+
+    bool try_push(T&& t) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for(;;) {
+            Cell& c = cells[pos & (N - 1)];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            std::ptrdiff_t dif = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+            if(dif == 0) {
+                if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (c.storage) T(std::move(t));
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(dif < 0) {
+                return false; // full
+            }
+            else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& out) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        for(;;) {
+            Cell& c = cells[pos & (N - 1)];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            std::ptrdiff_t dif = std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1);
+            if(dif == 0) {
+                if(dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* p = reinterpret_cast<T*>(c.storage);
+                    out = std::move(*p);
+                    p->~T();
+                    c.seq.store(pos + N, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(dif < 0) {
+                return false; // empty
+            }
+            else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+    Cell cells[N];
+    alignas(64) std::atomic<size_t> enqueue_pos;
+    alignas(64) std::atomic<size_t> dequeue_pos;
+};
+
+} // namespace thread_pool_detail
 
 class ThreadPool {
 public:
+    // Tasks each worker queue can hold before enqueue falls back to the shared overflow queue.
+    static const size_t QUEUE_CAPACITY = 1024;
+    // How many times an idle worker looks for work before going to sleep.
+    static const int SPIN_COUNT = 2000;
+
     ThreadPool(size_t);
     template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) 
+    auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
+    // fire-and-forget: no future, and no allocation if f fits in a Task. f must not throw.
+    template<class F>
+    void post(F&& f);
+    size_t size() const { return workers.size(); }
+    // pin worker i to the given cpu, returns false where that is not supported
+    bool pin(size_t i, unsigned cpu);
     ~ThreadPool();
 private:
+    using Task = thread_pool_detail::Task;
+    using Queue = thread_pool_detail::BoundedQueue<Task, QUEUE_CAPACITY>;
+
+    void push(Task&& task);
+    bool try_pop(size_t self, Task& task);
+    void run(size_t self);
+
+    // The worker index of the current thread, if it belongs to this pool.
+    size_t current_worker() const;
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
-    
-    // synchronization
-    std::mutex queue_mutex;
+    // the task queues, one per worker
+    std::vector< std::unique_ptr<Queue> > queues;
+    // only used when every queue is full
+    std::deque< Task > overflow;
+    std::mutex overflow_mutex;
+
+    // round robin for tasks enqueued from outside the pool
+    std::atomic<size_t> next_queue;
+    // tasks pushed but not yet popped
+    std::atomic<long> pending;
+
+    // synchronization, for parking only
+    std::atomic<int> sleepers;
+    std::mutex park_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<bool> stop;
+
+    static thread_local const ThreadPool* tls_pool;
+    static thread_local size_t tls_index;
 };
- 
+
+inline thread_local const ThreadPool* ThreadPool::tls_pool = nullptr;
+inline thread_local size_t ThreadPool::tls_index = 0;
+
 // the constructor just launches some amount of workers
 inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false)
+    :   next_queue(0), pending(0), sleepers(0), stop(false)
 {
     for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
-            {
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-        );
+        queues.emplace_back(new Queue());
+    for(size_t i = 0;i<threads;++i)
+        workers.emplace_back([this, i] { run(i); });
+}
+
+inline size_t ThreadPool::current_worker() const
+{
+    return tls_pool == this ? tls_index : queues.size();
+}
+
+inline void ThreadPool::push(Task&& task)
+{
+    // don't allow enqueueing after stopping the pool
+    if(stop.load(std::memory_order_relaxed))
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+
+    // Workers push to their own queue, everybody else spreads the tasks around.
+    size_t n = queues.size();
+    size_t self = current_worker();
+    size_t start = self < n ? self : next_queue.fetch_add(1, std::memory_order_relaxed) % n;
+    bool pushed = false;
+    for(size_t k = 0; k < n && !pushed; k++)
+        pushed = queues[(start + k) % n]->try_push(std::move(task));
+    if(!pushed) {
+        std::unique_lock<std::mutex> lock(overflow_mutex);
+        overflow.push_back(std::move(task));
+    }
+
+    // seq_cst on both sides: either the parking worker sees pending > 0, or we see it sleeping.
+    pending.fetch_add(1);
+    if(sleepers.load() > 0) {
+        std::unique_lock<std::mutex> lock(park_mutex);
+        condition.notify_one();
+    }
+}
+
+inline bool ThreadPool::try_pop(size_t self, Task& task)
+{
+    size_t n = queues.size();
+    // Our own queue first, then steal from the others.
+    for(size_t k = 0; k < n; k++) {
+        if(queues[(self + k) % n]->try_pop(task)) {
+            pending.fetch_sub(1);
+            return true;
+        }
+    }
+    std::unique_lock<std::mutex> lock(overflow_mutex);
+    if(!overflow.empty()) {
+        task = std::move(overflow.front());
+        overflow.pop_front();
+        pending.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+inline void ThreadPool::run(size_t self)
+{
+    tls_pool = this;
+    tls_index = self;
+    Task task;
+    for(;;)
+    {
+        bool found = false;
+        for(int spin = 0; spin < SPIN_COUNT && !found; spin++) {
+            if(pending.load(std::memory_order_relaxed) > 0)
+                found = try_pop(self, task);
+            if(!found && stop.load(std::memory_order_relaxed) && pending.load() == 0)
+                return;
+            if(!found && spin % 64 == 63)
+                std::this_thread::yield();
+        }
+        if(!found) {
+            std::unique_lock<std::mutex> lock(park_mutex);
+            sleepers.fetch_add(1);
+            this->condition.wait(lock,
+                [this]{ return this->stop.load() || this->pending.load() > 0; });
+            sleepers.fetch_sub(1);
+            continue;
+        }
+        task();
+        task = Task();
+    }
 }
 
 // add new work item to the pool
 template<class F, class... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args) 
+auto ThreadPool::enqueue(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type>
 {
     using return_type = typename std::result_of<F(Args...)>::type;
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
+    // The packaged_task itself is just a handle to the shared state the future needs,
+    // so it fits in a Task without another allocation.
+    std::packaged_task<return_type()> task(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
-        
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
-
-        tasks.emplace([task](){ (*task)(); });
-    }
-    condition.notify_one();
+    std::future<return_type> res = task.get_future();
+    push(Task(std::move(task)));
     return res;
 }
 
-// the destructor joins all threads
+template<class F>
+void ThreadPool::post(F&& f)
+{
+    push(Task(std::forward<F>(f)));
+}
+
+inline bool ThreadPool::pin(size_t i, unsigned cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(workers.at(i).native_handle(), sizeof(set), &set) == 0;
+#else
+    (void)i;
+    (void)cpu;
+    return false;
+#endif
+}
+
+// the destructor runs whatever is left and joins all threads
 inline ThreadPool::~ThreadPool()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(park_mutex);
         stop = true;
     }
     condition.notify_all();
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "zobrist.hpp"
+
+/**
+ * A fixed-size, lock-free transposition table for the DFS.
+ *
+ * Many paths reach the same (board, cursor) state, e.g. dragging the cursor through orbs of its
+ * own color leaves the board unchanged. Everything below a state only depends on the state and on
+ * how many moves are left, so if we have already expanded it at a depth no deeper than the current
+ * one (i.e. with at least as many moves remaining), the current subtree cannot produce a shorter
+ * solution for any combo count and can be skipped.
+ *
+ * Each slot is a single atomic word: [ tag : 40 | epoch : 16 | depth : 8 ].
+ * The tag is the top of the hash (the bottom indexes the slot), and the epoch lets us start a new
+ * search without clearing the table. Collisions simply overwrite: this is a cache, not a set.
+ */
+
+namespace pad {
+
+class TranspositionTable {
+public:
+    // By default 2^17 slots, i.e. 1MB. Bigger tables catch a few more transpositions but
+    // the cache misses cost more than the subtrees they save.
+    static const int DEFAULT_SIZE_LOG2 = 17;
+
+    explicit TranspositionTable(int size_log2 = DEFAULT_SIZE_LOG2)
+        : slots(new std::atomic<std::uint64_t>[std::size_t(1) << size_log2]),
+          mask((std::uint64_t(1) << size_log2) - 1),
+          epoch(1)
+    {
+        clear();
+    }
+
+    // Entries from a previous search are ignored after this.
+    void new_search() noexcept {
+        epoch = (epoch + 1) & EPOCH_MASK;
+        if(epoch == 0) {
+            clear();
+            epoch = 1;
+        }
+    }
+
+    // Returns true if the state was already expanded at a depth <= depth during this search,
+    // in which case the caller should skip it. Otherwise remembers depth for this state.
+    bool probe(Hash key, int depth) noexcept {
+        std::atomic<std::uint64_t>& slot = slots[key & mask];
+        std::uint64_t tag = (key >> TAG_SHIFT) << TAG_SHIFT;
+        std::uint64_t mine = tag | (std::uint64_t(epoch) << DEPTH_BITS) | std::uint64_t(depth);
+        std::uint64_t cur = slot.load(std::memory_order_relaxed);
+        for(;;) {
+            bool same = (cur & ~DEPTH_MASK) == (mine & ~DEPTH_MASK);
+            if(same && int(cur & DEPTH_MASK) <= depth)
+                return true;
+            // Either a shallower visit of our state, or someone else's slot: take it over.
+            if(slot.compare_exchange_weak(cur, mine, std::memory_order_relaxed))
+                return false;
+        }
+    }
+
+    std::size_t size() const noexcept {
+        return mask + 1;
+    }
+
+private:
+    static const int DEPTH_BITS = 8;
+    static const int EPOCH_BITS = 16;
+    static const int TAG_SHIFT = DEPTH_BITS + EPOCH_BITS;
+    static const std::uint64_t DEPTH_MASK = (std::uint64_t(1) << DEPTH_BITS) - 1;
+    static const unsigned EPOCH_MASK = (1u << EPOCH_BITS) - 1;
+
+    void clear() noexcept {
+        for(std::size_t i = 0; i <= mask; i++)
+            slots[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+    std::uint64_t mask;
+    unsigned epoch;
+};
+
+} // namespace pad
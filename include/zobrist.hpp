@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "detail.hpp"
+#include "state.hpp"
+#include "bitboard.hpp"
+
+/**
+ * Zobrist hashing: every (cell, orb) pair and every cursor position gets a random 64-bit key,
+ * and a position hashes to the XOR of the keys it contains. Swapping two orbs only changes four
+ * (cell, orb) keys, so the hash can be maintained incrementally as the search moves.
+ *
+ * The board hash and the cursor key are kept apart, since a scored board does not care
+ * where the cursor is but a search node does.
+ */
+
+namespace pad {
+
+using Hash = std::uint64_t;
+
+namespace detail {
+// splitmix64, so the keys are fixed at compile time and identical across runs.
+inline constexpr Hash splitmix64(Hash& state) noexcept {
+    Hash z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+template <int NumOrbs>
+inline constexpr std::array<std::array<Hash, consts::NUM_PLANES>, NumOrbs> make_orb_keys() noexcept {
+    std::array<std::array<Hash, consts::NUM_PLANES>, NumOrbs> keys {};
+    Hash state = 0x5eed;
+    for(int i = 0; i < NumOrbs; i++)
+        for(int k = 0; k < consts::NUM_PLANES; k++)
+            keys[i][k] = splitmix64(state);
+    return keys;
+}
+
+template <int NumOrbs>
+inline constexpr std::array<Hash, NumOrbs> make_cursor_keys() noexcept {
+    std::array<Hash, NumOrbs> keys {};
+    Hash state = 0xc0ffee;
+    for(int i = 0; i < NumOrbs; i++)
+        keys[i] = splitmix64(state);
+    return keys;
+}
+} // namespace detail
+
+// One set of keys per board size.
+template <std::size_t Rows, std::size_t Cols>
+struct ZobristKeys {
+    // Indexed by [cell_index][orb].
+    static constexpr auto ORB = detail::make_orb_keys<Dims<Rows, Cols>::NUM_ORBS>();
+    // Indexed by cell_index.
+    static constexpr auto CURSOR = detail::make_cursor_keys<Dims<Rows, Cols>::NUM_ORBS>();
+};
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+inline Hash orb_key(const Coord& coord, Orb o) noexcept {
+    return ZobristKeys<Rows, Cols>::ORB[Layout<Rows, Cols>::cell_index(coord.first, coord.second)][detail::enum_value(o)];
+}
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+inline Hash cursor_key(const Coord& coord) noexcept {
+    return ZobristKeys<Rows, Cols>::CURSOR[Layout<Rows, Cols>::cell_index(coord.first, coord.second)];
+}
+
+template <std::size_t Rows, std::size_t Cols>
+Hash board_hash(const BoardT<Rows, Cols>& b) noexcept {
+    Hash h = 0;
+    for(int i = 0; i < int(Rows); i++) {
+        for(int j = 0; j < int(Cols); j++) {
+            h ^= orb_key<Rows, Cols>({i, j}, b[i][j]);
+        }
+    }
+    return h;
+}
+
+} // namespace pad
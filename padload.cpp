@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "socket.hpp"
+
+/**
+ * A load generator for padsolved: --clients connections each send --requests random boards, one at a
+ * time (the next one goes out when the answer to the last one is back), and the latencies of all of
+ * them are reported at the end.
+ *
+ *   build/padsolved &
+ *   build/padload -c 8 -n 200 --options "depth=10"
+ *
+ * The boards only depend on --seed, so two runs against different servers send the same requests.
+ */
+
+using namespace pad;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* USAGE =
+    "usage: padload [options]\n"
+    "  -a, --address ADDRESS   socket path, or a port on 127.0.0.1 (default /tmp/padsolved.sock)\n"
+    "  -c, --clients N         connections at the same time (default 4)\n"
+    "  -n, --requests N        requests per connection (default 100)\n"
+    "  -o, --options OPTIONS   appended to every request, e.g. \"depth=12 deadline_ms=50\"\n"
+    "      --seed N            seed for the random boards (default 1)\n";
+
+struct Options {
+    std::string address = "/tmp/padsolved.sock";
+    int clients = 4;
+    int requests = 100;
+    std::string options;
+    unsigned seed = 1;
+};
+
+[[noreturn]] void usage_error(const std::string& message) {
+    std::cerr << "padload: " << message << "\n" << USAGE;
+    std::exit(2);
+}
+
+long parse_number(const char* flag, const char* value) {
+    if(!value)
+        usage_error(std::string(flag) + " needs a value");
+    char* end;
+    long n = std::strtol(value, &end, 10);
+    if(*end || n < 0)
+        usage_error(std::string("bad value for ") + flag + ": " + value);
+    return n;
+}
+
+Options parse_options(int argc, char** argv) {
+    Options opts;
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if(arg == "-h" || arg == "--help") {
+            std::cout << USAGE;
+            std::exit(0);
+        } else if(arg == "-a" || arg == "--address") {
+            if(!value)
+                usage_error(arg + " needs a value");
+            opts.address = value;
+        } else if(arg == "-o" || arg == "--options") {
+            if(!value)
+                usage_error(arg + " needs a value");
+            opts.options = value;
+        } else if(arg == "-c" || arg == "--clients") {
+            opts.clients = std::max(1L, parse_number(argv[i], value));
+        } else if(arg == "-n" || arg == "--requests") {
+            opts.requests = std::max(1L, parse_number(argv[i], value));
+        } else if(arg == "--seed") {
+            opts.seed = parse_number(argv[i], value);
+        } else {
+            usage_error("unknown option: " + arg);
+        }
+        i++;
+    }
+    return opts;
+}
+
+// A random 5x6 board.
+std::string random_board(std::mt19937& rng) {
+    static const char ORBS[] = "ldrbgh";
+    std::uniform_int_distribution<int> orb(0, 5);
+    std::string board;
+    for(int i = 0; i < 30; i++)
+        board.push_back(ORBS[orb(rng)]);
+    return board;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if(sorted.empty())
+        return 0;
+    size_t i = std::min(sorted.size() - 1, size_t(p / 100 * sorted.size()));
+    return sorted[i];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts = parse_options(argc, argv);
+
+    std::vector<std::vector<double>> latencies(opts.clients);
+    std::atomic<long> errors {0};
+    std::atomic<bool> failed {false};
+    auto start = Clock::now();
+    std::vector<std::thread> clients;
+    for(int c = 0; c < opts.clients; c++) {
+        clients.emplace_back([&, c]() {
+            std::mt19937 rng(opts.seed * 7919 + c);
+            int fd;
+            try {
+                fd = net::connect_to(opts.address);
+            } catch(const std::runtime_error& e) {
+                if(!failed.exchange(true))
+                    std::cerr << "padload: " << e.what() << "\n";
+                return;
+            }
+            net::LineReader reader(fd);
+            std::string answer;
+            for(int i = 0; i < opts.requests; i++) {
+                std::string line = random_board(rng) + " " + opts.options + "\n";
+                auto sent = Clock::now();
+                if(!net::write_all(fd, line) || !reader.next(answer)) {
+                    if(!failed.exchange(true))
+                        std::cerr << "padload: the server hung up\n";
+                    break;
+                }
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent).count());
+                if(answer.find(" error ") != std::string::npos || answer.find("\"error\"") != std::string::npos)
+                    errors++;
+            }
+            close(fd);
+        });
+    }
+    for(auto& t : clients)
+        t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> all;
+    for(const auto& l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    std::printf("requests: %zu (%ld errors) in %.2fs, %.1f requests/s\n", all.size(), errors.load(), seconds, all.size() / seconds);
+    std::printf("latency ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n", percentile(all, 50), percentile(all, 90),
+                percentile(all, 99), all.empty() ? 0 : all.back());
+    return failed ? 1 : 0;
+}
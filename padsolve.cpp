@@ -0,0 +1,189 @@
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include "solver.hpp"
+#include "request.hpp"
+
+/**
+ * Solves a stream of boards, one per line, and writes one result line per board in input order.
+ *
+ *   build/padsolve [options] [file]     # reads stdin without a file
+ *
+ * Every line is a request as include/request.hpp describes it, usually just the board, and the options
+ * set the defaults for all of them. Blank lines are skipped, anything else that can't be solved gets
+ * an error line in its place.
+ *
+ * --jobs boards are solved at the same time, each on its own board thread, and --threads is the total
+ * number of threads: whatever the board threads leave over goes to a Solver pool that all the searches
+ * share. The default, one job per thread, gives every board a single thread and is the fastest way
+ * through a large dump; --jobs 1 gives every thread to one board at a time instead.
+ *
+ * The board threads are a pool of their own, not the Solver's: a search waits for the helper tasks it
+ * hands to the Solver's pool, and if those were queued behind more searches on the same pool, every
+ * worker could end up waiting on tasks that nobody is left to run.
+ */
+
+using namespace pad;
+
+namespace {
+
+struct Options {
+    // What every board is solved with, unless its line says otherwise.
+    request::Request defaults;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned jobs = 0;
+    size_t cache_mb = ScoreCache::DEFAULT_BYTES >> 20;
+    const char* file = nullptr;
+};
+
+const char* USAGE =
+    "usage: padsolve [options] [file]\n"
+    "  -a, --algorithm dfs|beam|until  search to use (default dfs)\n"
+    "  -d, --depth N                   maximum moves (default 10)\n"
+    "  -t, --threads N                 total threads (default: all of them)\n"
+    "  -j, --jobs N                    boards solved at the same time (default: --threads)\n"
+    "  -w, --beam-width N              beam width for beam (default 5000)\n"
+    "      --time-ms N                 time per board for until (default 100)\n"
+    "      --smart                     only search from the most promising starting points\n"
+    "      --bound                     cut subtrees by a heuristic bound: faster, but can miss\n"
+    "                                  the best path (dfs and until)\n"
+    "      --cache-mb N                score cache shared by all boards, 0 for none\n"
+    "      --json                      one JSON object per board instead of a compact line\n"
+    "A line can also override these for its board, see include/request.hpp.\n";
+
+// Far more than any machine this runs on, but small enough that a typo can't ask for billions of threads.
+const long MAX_THREADS = 1024;
+// So that cache_mb << 20 still fits in a size_t.
+const long MAX_CACHE_MB = long(SIZE_MAX >> 20);
+
+[[noreturn]] void usage_error(const std::string& message) {
+    std::cerr << "padsolve: " << message << "\n" << USAGE;
+    std::exit(2);
+}
+
+long parse_number(const char* flag, const char* value, long max = LONG_MAX) {
+    if(!value)
+        usage_error(std::string(flag) + " needs a value");
+    char* end;
+    long n = std::strtol(value, &end, 10);
+    if(*end || n < 0 || n > max)
+        usage_error(std::string("bad value for ") + flag + ": " + value);
+    return n;
+}
+
+Options parse_options(int argc, char** argv) {
+    Options opts;
+    request::Request& req = opts.defaults;
+    bool until = false;
+    long time_ms = 100;
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if(arg == "-h" || arg == "--help") {
+            std::cout << USAGE;
+            std::exit(0);
+        } else if(arg == "-a" || arg == "--algorithm") {
+            std::string name = value ? value : "";
+            until = name == "until";
+            if(!until && !request::parse_algorithm(name, req.algorithm))
+                usage_error("unknown algorithm: " + name);
+            i++;
+        } else if(arg == "-d" || arg == "--depth") {
+            req.depth = parse_number(argv[i], value, Solution::MAX_LENGTH);
+            i++;
+        } else if(arg == "-t" || arg == "--threads") {
+            opts.threads = std::max(1L, parse_number(argv[i], value, MAX_THREADS));
+            i++;
+        } else if(arg == "-j" || arg == "--jobs") {
+            opts.jobs = std::max(1L, parse_number(argv[i], value, MAX_THREADS));
+            i++;
+        } else if(arg == "-w" || arg == "--beam-width") {
+            req.beam_width = std::max(1L, parse_number(argv[i], value, request::MAX_BEAM_WIDTH));
+            i++;
+        } else if(arg == "--time-ms") {
+            time_ms = parse_number(argv[i], value, request::MAX_DEADLINE_MS);
+            i++;
+        } else if(arg == "--cache-mb") {
+            opts.cache_mb = parse_number(argv[i], value, MAX_CACHE_MB);
+            i++;
+        } else if(arg == "--smart") {
+            req.smart = true;
+        } else if(arg == "--bound") {
+            req.bound = true;
+        } else if(arg == "--json") {
+            req.json = true;
+        } else if(arg.size() > 1 && arg[0] == '-') {
+            usage_error("unknown option: " + arg);
+        } else if(!opts.file) {
+            opts.file = argv[i];
+        } else {
+            usage_error("only one input file, please");
+        }
+    }
+    // until is dfs with a deadline, counted from when the board is picked up.
+    if(until) {
+        req.algorithm = request::Algorithm::dfs;
+        req.deadline_ms = std::max(1L, time_ms);
+    }
+    if(!opts.jobs || opts.jobs > opts.threads)
+        opts.jobs = opts.threads;
+    return opts;
+}
+
+std::string trim(const std::string& s) {
+    size_t first = s.find_first_not_of(" \t\r");
+    if(first == std::string::npos)
+        return "";
+    return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+    Options opts = parse_options(argc, argv);
+
+    std::ifstream file;
+    if(opts.file) {
+        file.open(opts.file);
+        if(!file) {
+            std::cerr << "padsolve: cannot open " << opts.file << "\n";
+            return 1;
+        }
+    }
+    std::istream& in = opts.file ? file : std::cin;
+
+    Solver solver(opts.threads - opts.jobs, AffinityPolicy::none, opts.cache_mb << 20);
+    ThreadPool boards(opts.jobs);
+    // Enough boards queued that no board thread waits on the reader, but not the whole dump.
+    const size_t window = 4 * opts.jobs;
+    std::deque<std::future<std::string>> pending;
+
+    std::string line;
+    while(std::getline(in, line)) {
+        std::string board = trim(line);
+        if(board.empty())
+            continue;
+        pending.push_back(boards.enqueue([&solver, &opts, board]() {
+            return request::answer(solver, board, opts.defaults);
+        }));
+        // Results go out in input order, as soon as the oldest board is done.
+        while(pending.size() >= window || (!pending.empty() && pending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+            std::cout << pending.front().get() << "\n";
+            pending.pop_front();
+        }
+        std::cout.flush();
+    }
+    while(!pending.empty()) {
+        std::cout << pending.front().get() << "\n";
+        pending.pop_front();
+    }
+    std::cout.flush();
+    return 0;
+}
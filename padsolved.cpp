@@ -0,0 +1,248 @@
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "solver.hpp"
+#include "request.hpp"
+#include "socket.hpp"
+
+/**
+ * A long-running solver: the pools, the score cache and the transposition tables stay warm from one
+ * request to the next, instead of every request paying for a new process.
+ *
+ *   build/padsolved [options]              # listens on /tmp/padsolved.sock
+ *   build/padsolved --listen 7777          # or on 127.0.0.1:7777
+ *
+ * Clients send request lines (see include/request.hpp) and get one answer line per request, in the
+ * order they sent them. A client may send more requests before the answers come back, and the
+ * requests of every client go through the same queue, so concurrent requests are solved side by side
+ * the same way padsolve pipelines a file: --jobs requests at a time on request threads, with whatever
+ * --threads leaves over helping them in a shared work-stealing Solver pool. The request threads are a
+ * pool of their own so that they never wait on tasks queued behind themselves.
+ *
+ * A deadline_ms counts from when the request was read, so time spent queued behind other requests
+ * counts against it. Every request gets one: a request without gets --deadline-ms, and none can ask
+ * for more than --max-deadline-ms (or more than --max-depth), so that no client can keep a request
+ * thread busy for long. A client that sends a line longer than --max-line, or gets more than
+ * --max-pending answers behind, is hung up on, so that no client can make the daemon hold on to an
+ * unbounded amount of memory either. build/padload is a load generator for trying it out.
+ */
+
+using namespace pad;
+
+namespace {
+
+const char* USAGE =
+    "usage: padsolved [options]\n"
+    "  -l, --listen ADDRESS    socket path, or a port on 127.0.0.1 (default /tmp/padsolved.sock)\n"
+    "  -t, --threads N         total solver threads (default: all of them)\n"
+    "  -j, --jobs N            requests solved at the same time (default: --threads)\n"
+    "  -d, --depth N           default depth (default 10)\n"
+    "      --deadline-ms N     default deadline (default 1000)\n"
+    "      --max-deadline-ms N deadline of requests that ask for none or a later one (default 10000)\n"
+    "      --max-depth N       requests asking for a deeper search get an error (default 15)\n"
+    "      --max-beam-width N  requests asking for a wider beam get an error (default 20000)\n"
+    "      --max-pending N     requests a client can have waiting for their answer (default 64)\n"
+    "      --max-line N        longest request line, in bytes (default 4096)\n"
+    "      --cache-mb N        score cache shared by all requests, 0 for none\n";
+
+request::Request default_request() {
+    request::Request req;
+    req.deadline_ms = 1000;
+    return req;
+}
+
+request::Limits default_limits() {
+    request::Limits limits;
+    limits.max_depth = dfs::MAX_DEPTH;
+    limits.max_beam_width = 20000;
+    limits.max_deadline_ms = 10000;
+    return limits;
+}
+
+struct Options {
+    std::string address = "/tmp/padsolved.sock";
+    request::Request defaults = default_request();
+    request::Limits limits = default_limits();
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned jobs = 0;
+    size_t cache_mb = ScoreCache::DEFAULT_BYTES >> 20;
+    size_t max_pending = 64;
+    size_t max_line = 4096;
+};
+
+// Far more than any machine this runs on, but small enough that a typo can't ask for billions of threads.
+const long MAX_THREADS = 1024;
+// So that cache_mb << 20 still fits in a size_t.
+const long MAX_CACHE_MB = long(SIZE_MAX >> 20);
+
+[[noreturn]] void usage_error(const std::string& message) {
+    std::cerr << "padsolved: " << message << "\n" << USAGE;
+    std::exit(2);
+}
+
+long parse_number(const char* flag, const char* value, long max = LONG_MAX) {
+    if(!value)
+        usage_error(std::string(flag) + " needs a value");
+    char* end;
+    long n = std::strtol(value, &end, 10);
+    if(*end || n < 0 || n > max)
+        usage_error(std::string("bad value for ") + flag + ": " + value);
+    return n;
+}
+
+Options parse_options(int argc, char** argv) {
+    Options opts;
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if(arg == "-h" || arg == "--help") {
+            std::cout << USAGE;
+            std::exit(0);
+        } else if(arg == "-l" || arg == "--listen") {
+            if(!value)
+                usage_error(arg + " needs a value");
+            opts.address = value;
+        } else if(arg == "-t" || arg == "--threads") {
+            opts.threads = std::max(1L, parse_number(argv[i], value, MAX_THREADS));
+        } else if(arg == "-j" || arg == "--jobs") {
+            opts.jobs = std::max(1L, parse_number(argv[i], value, MAX_THREADS));
+        } else if(arg == "-d" || arg == "--depth") {
+            opts.defaults.depth = parse_number(argv[i], value, Solution::MAX_LENGTH);
+        } else if(arg == "--deadline-ms") {
+            opts.defaults.deadline_ms = std::max(1L, parse_number(argv[i], value, request::MAX_DEADLINE_MS));
+        } else if(arg == "--max-deadline-ms") {
+            opts.limits.max_deadline_ms = std::max(1L, parse_number(argv[i], value, request::MAX_DEADLINE_MS));
+        } else if(arg == "--max-depth") {
+            opts.limits.max_depth = parse_number(argv[i], value, Solution::MAX_LENGTH);
+        } else if(arg == "--max-beam-width") {
+            opts.limits.max_beam_width = std::max(1L, parse_number(argv[i], value, request::MAX_BEAM_WIDTH));
+        } else if(arg == "--max-pending") {
+            opts.max_pending = std::max(1L, parse_number(argv[i], value));
+        } else if(arg == "--max-line") {
+            opts.max_line = std::max(1L, parse_number(argv[i], value));
+        } else if(arg == "--cache-mb") {
+            opts.cache_mb = parse_number(argv[i], value, MAX_CACHE_MB);
+        } else {
+            usage_error("unknown option: " + arg);
+        }
+        i++;
+    }
+    if(opts.defaults.depth > opts.limits.max_depth)
+        usage_error("--depth is above --max-depth");
+    opts.defaults.deadline_ms = std::min(opts.defaults.deadline_ms, opts.limits.max_deadline_ms);
+    opts.defaults.beam_width = std::min<long>(opts.defaults.beam_width, opts.limits.max_beam_width);
+    if(!opts.jobs || opts.jobs > opts.threads)
+        opts.jobs = opts.threads;
+    return opts;
+}
+
+class Service {
+public:
+    explicit Service(const Options& opts)
+        : defaults(opts.defaults),
+          limits(opts.limits),
+          max_pending(opts.max_pending),
+          max_line(opts.max_line),
+          solver(opts.threads - opts.jobs, AffinityPolicy::none, opts.cache_mb << 20),
+          requests(opts.jobs) {}
+
+    // Answers one client until it hangs up (or breaks a limit, see above). The calling thread reads, a
+    // second one writes the answers.
+    void serve(int fd) {
+        std::deque<std::future<std::string>> pending;
+        std::mutex mutex;
+        std::condition_variable ready;
+        bool eof = false;
+
+        std::thread writer([&]() {
+            bool connected = true;
+            for(;;) {
+                std::future<std::string> answer;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&]() { return eof || !pending.empty(); });
+                    if(pending.empty())
+                        return;
+                    answer = std::move(pending.front());
+                    pending.pop_front();
+                }
+                // Once the client is gone, the rest of its answers are still waited for, just not sent.
+                std::string line = answer.get() + "\n";
+                connected = connected && net::write_all(fd, line);
+            }
+        });
+
+        net::LineReader reader(fd, max_line);
+        std::string line;
+        bool too_many = false;
+        while(!too_many && reader.next(line)) {
+            auto received = dfs::Clock::now();
+            if(line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            std::lock_guard<std::mutex> lock(mutex);
+            too_many = pending.size() >= max_pending;
+            if(too_many)
+                break;
+            pending.push_back(requests.enqueue([this, line, received]() {
+                return request::answer(solver, line, defaults, limits, received);
+            }));
+            ready.notify_one();
+        }
+        if(too_many || reader.too_long()) {
+            std::cerr << "padsolved: hanging up on a client with " << (too_many ? "too many requests pending" : "too long a line") << "\n";
+            // The writer's sends fail from here on, so it only waits for what is already queued.
+            shutdown(fd, SHUT_RDWR);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            eof = true;
+            ready.notify_one();
+        }
+        writer.join();
+        close(fd);
+    }
+
+private:
+    const request::Request defaults;
+    const request::Limits limits;
+    const size_t max_pending;
+    const size_t max_line;
+    Solver solver;
+    ThreadPool requests;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts = parse_options(argc, argv);
+    Service service(opts);
+    int listen_fd;
+    try {
+        listen_fd = net::listen_on(opts.address);
+    } catch(const std::runtime_error& e) {
+        std::cerr << "padsolved: " << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "padsolved: listening on " << opts.address << " with " << opts.threads << " threads, "
+              << opts.jobs << " requests at a time\n";
+    for(;;) {
+        int fd;
+        try {
+            fd = net::accept_from(listen_fd);
+        } catch(const std::runtime_error& e) {
+            // Out of file descriptors and the like, the clients we have are still fine.
+            std::cerr << "padsolved: " << e.what() << "\n";
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        std::thread([&service, fd]() { service.serve(fd); }).detach();
+    }
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "catch.hpp"
 #include "../include/action.hpp"
+#include "../include/search_state.hpp"
 
 using namespace pad;
 
@@ -90,3 +91,86 @@ TEST_CASE( "Populate will only populate 2 things in corners.", "[populate]" ) {
         REQUIRE( v.size() == 4 );
     }
 }
+
+TEST_CASE( "apply_move and undo_move mirror move() in place.", "[apply_move]" ) {
+    static const std::string BOARD = "bhhhdhbhdhhhbhlllhddrbbhrrgggb";
+    Board b = initialize(BOARD);
+    SearchState s = make_search_state(b, {2, 2});
+
+    // Walk a small loop and compare against the copying API at every step.
+    Board expected = b;
+    Coord c {2, 2};
+    const std::vector<Action> path = { Action::up, Action::right, Action::down, Action::down, Action::left };
+    for(const Action& a : path) {
+        Coord next = change_coords(c, a);
+        expected = move(expected, c, next);
+        c = next;
+        apply_move(s, a);
+        REQUIRE(s.cursor == c);
+        REQUIRE(s.board == expected);
+        REQUIRE(s.bits == to_bitboard(expected));
+    }
+    for(auto it = path.rbegin(); it != path.rend(); ++it) {
+        undo_move(s, *it);
+    }
+    REQUIRE(s.cursor == Coord {2, 2});
+    REQUIRE(s.board == b);
+    REQUIRE(s.bits == to_bitboard(b));
+
+    // Scoring the state does not destroy it.
+    Board copy = b;
+    REQUIRE(score(s) == score(copy));
+    REQUIRE(s.board == b);
+    REQUIRE(s.bits == to_bitboard(b));
+}
+
+TEST_CASE( "Zobrist hash is maintained incrementally.", "[zobrist]" ) {
+    static const std::string BOARD = "bhhhdhbhdhhhbhlllhddrbbhrrgggb";
+    Board b = initialize(BOARD);
+    SearchState s = make_search_state(b, {4, 0});
+    const Hash start = state_key(s);
+    const std::vector<Action> path = { Action::up, Action::up, Action::right, Action::right, Action::down };
+    for(const Action& a : path) {
+        apply_move(s, a);
+        REQUIRE(s.hash == board_hash(s.board));
+    }
+    REQUIRE(state_key(s) != start);
+    for(auto it = path.rbegin(); it != path.rend(); ++it) {
+        undo_move(s, *it);
+    }
+    REQUIRE(state_key(s) == start);
+    // Same board, different cursor.
+    REQUIRE(state_key(make_search_state(b, {0, 0})) != start);
+    REQUIRE(make_search_state(b, {0, 0}).hash == s.hash);
+}
+
+TEST_CASE( "First wave matches are maintained incrementally.", "[apply_move]" ) {
+    static const std::string BOARD = "bhhhdhbhdhhhbhlllhddrbbhrrgggb";
+    Board b = initialize(BOARD);
+    SearchState s = make_search_state(b, {4, 0});
+    auto check = [&]() {
+        for(int k = 0; k < consts::NUM_PLANES; k++) {
+            if(Orb(k) != Orb::empty)
+                REQUIRE(s.matched[k] == detail::match_mask(s.bits.planes[k]));
+        }
+        Board copy = s.board;
+        REQUIRE(score(s) == score(copy));
+    };
+    check();
+    const std::vector<Action> path = { Action::up, Action::up, Action::right, Action::right, Action::down,
+                                       Action::down, Action::right, Action::up, Action::up, Action::up };
+    for(const Action& a : path) {
+        apply_move(s, a);
+        check();
+    }
+    for(auto it = path.rbegin(); it != path.rend(); ++it) {
+        undo_move(s, *it);
+        check();
+    }
+    REQUIRE(s.matched == make_search_state(b, {4, 0}).matched);
+
+    // Nothing to clear, so no cascade to run.
+    SearchState none = make_search_state(initialize("RGBLDHGBLDHRBLDHRGLDHRGBDHRGBL"), {0, 0});
+    REQUIRE(!has_matches(none));
+    REQUIRE(score(none) == 0);
+}
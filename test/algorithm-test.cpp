@@ -3,6 +3,8 @@
 #include "catch.hpp"
 #include "../include/display.hpp"
 #include "../include/algorithm.hpp"
+#include "../include/beam.hpp"
+#include "../include/solver.hpp"
 
 using namespace pad;
 
@@ -91,3 +93,494 @@ TEST_CASE( "run from a smart-select group of coordinates.", "[dfs]" ) {
         std::cout << display::analyze_combos(map) << std::endl;
     }
 }
+
+TEST_CASE( "transposition table does not change solution lengths.", "[dfs][transposition]" ) {
+    static const std::string COMPLICATED_BOARD =
+        "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+    using namespace dfs;
+    Board b = initialize(COMPLICATED_BOARD);
+    int max_combos = max_combos_possible(b);
+    TranspositionTable tt;
+    for(const Coord& c : { Coord {0, 0}, Coord {2, 3}, Coord {4, 5} }) {
+        SolutionMap plain, cached;
+        for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
+            plain.emplace_back(c);
+            cached.emplace_back(c);
+        }
+        tt.new_search();
+        dfs_find(b, c, max_combos, plain, 10);
+        dfs_find(b, c, max_combos, cached, 10, &tt);
+        for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
+            REQUIRE(plain[k].size() == cached[k].size());
+        }
+    }
+    SECTION( "probe only skips states seen at the same depth or shallower" ) {
+        tt.new_search();
+        REQUIRE(!tt.probe(0x1234567890abcdefULL, 5));
+        REQUIRE(tt.probe(0x1234567890abcdefULL, 5));
+        REQUIRE(tt.probe(0x1234567890abcdefULL, 7));
+        REQUIRE(!tt.probe(0x1234567890abcdefULL, 3));
+        tt.new_search();
+        REQUIRE(!tt.probe(0x1234567890abcdefULL, 7));
+    }
+}
+
+TEST_CASE( "the score cache remembers scores and counts hits.", "[dfs][score_cache]" ) {
+    static const std::string COMPLICATED_BOARD =
+        "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+    using namespace dfs;
+    SECTION( "lookups, eviction and the memory cap" ) {
+        ScoreCache cache(1000);
+        REQUIRE(cache.size() == 64);
+        REQUIRE(cache.bytes() <= 1000);
+        int score = -1;
+        REQUIRE(!cache.lookup(0x1234567890abcdefULL, score));
+        cache.insert(0x1234567890abcdefULL, 0);
+        REQUIRE(cache.lookup(0x1234567890abcdefULL, score));
+        REQUIRE(score == 0);
+        // Same slot, different board: the old one is evicted.
+        cache.insert(0xfedcba98765432efULL, 7);
+        REQUIRE(!cache.lookup(0x1234567890abcdefULL, score));
+        REQUIRE(cache.lookup(0xfedcba98765432efULL, score));
+        REQUIRE(score == 7);
+        REQUIRE(cache.hits() == 2);
+        REQUIRE(cache.misses() == 2);
+        cache.reset_counters();
+        REQUIRE(cache.hits() + cache.misses() == 0);
+    }
+    SECTION( "does not change solution lengths" ) {
+        Board b = initialize(COMPLICATED_BOARD);
+        SolutionMap reference = find_combos(b, 8);
+        ScoreCache cache;
+        SearchOptions opts;
+        opts.max_depth = 8;
+        opts.cache = &cache;
+        std::uint64_t hits[2];
+        for(int n = 0; n < 2; n++) {
+            cache.reset_counters();
+            SolutionMap map = find_combos(b, opts);
+            for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
+                REQUIRE(map[k].size() == reference[k].size());
+            }
+            hits[n] = cache.hits();
+        }
+        // The second call starts with a warm cache.
+        REQUIRE(hits[0] > 0);
+        REQUIRE(hits[1] > hits[0]);
+    }
+}
+
+TEST_CASE( "beam search reaches deeper than DFS.", "[beam]" ) {
+    using beam::SolutionMap;
+    SECTION( "finds the 10-combo on the complicated board" ) {
+        // http://pad.dawnglare.com/?s=EYb3aJ0
+        static const std::string COMPLICATED_BOARD =
+            "brbbrrrgrggrglgllgldlddldhdhhd";
+        SolutionMap map = beam::find_combos(initialize(COMPLICATED_BOARD));
+        REQUIRE(map[10].size() != 0);
+        REQUIRE(map[10].size() <= 16);
+    }
+    SECTION( "finds the 8-combo that a depth 15 DFS cannot" ) {
+        // http://pad.dawnglare.com/?s=DnAuYk0
+        static const std::string COMPLICATED_BOARD =
+            "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+        SolutionMap map = beam::find_combos(initialize(COMPLICATED_BOARD), 40);
+        REQUIRE(map[8].size() != 0);
+        // Replaying the path has to give the combos it claims.
+        Board b = initialize(COMPLICATED_BOARD);
+        Coord c = map[8].get_origin();
+        for(const Action& a : map[8].get_all_action()) {
+            Coord next = change_coords(c, a);
+            b = move(b, c, next);
+            c = next;
+        }
+        REQUIRE(score(b) == 8);
+    }
+    SECTION( "a narrow beam still returns valid solutions" ) {
+        static const std::string COMPLICATED_BOARD =
+            "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+        SolutionMap map = beam::find_combos(initialize(COMPLICATED_BOARD), 20, true, dfs::NUM_TO_POPULATE, 1);
+        int found = 0;
+        for(const auto& sol : map) {
+            REQUIRE(sol.size() <= 20);
+            found += (sol.size() != 0);
+        }
+        REQUIRE(found != 0);
+    }
+    SECTION( "stops at the deadline" ) {
+        static const std::string COMPLICATED_BOARD =
+            "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+        SolutionMap map = beam::find_combos(initialize(COMPLICATED_BOARD), 40, false, dfs::NUM_TO_POPULATE, beam::BEAM_WIDTH,
+                                            nullptr, dfs::Clock::now() - std::chrono::seconds(1));
+        for(const auto& sol : map) {
+            REQUIRE(sol.size() == 0);
+        }
+    }
+}
+
+// Every path in the map has to actually make the number of combos it is filed under.
+template <std::size_t Rows, std::size_t Cols>
+static void check_replays(const BoardT<Rows, Cols>& b, const dfs::SolutionMap& map) {
+    for(size_t k = 1; k < map.size(); k++) {
+        if(map[k].size() == 0)
+            continue;
+        auto s = make_search_state(b, map[k].get_origin());
+        for(const Action& a : map[k].get_all_action())
+            apply_move(s, a);
+        REQUIRE(score(s) == int(k));
+    }
+}
+
+TEST_CASE( "iterative deepening respects the deadline.", "[dfs][deadline]" ) {
+    // http://pad.dawnglare.com/?s=DnAuYk0
+    static const std::string COMPLICATED_BOARD =
+        "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+    using namespace dfs;
+    Board b = initialize(COMPLICATED_BOARD);
+    SECTION( "a generous deadline gives the same lengths as a fixed depth search" ) {
+        SolutionMap fixed = find_combos(b, 8);
+        SolutionMap deepened = find_combos_until(b, Clock::now() + std::chrono::hours(1), 8);
+        for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
+            REQUIRE(fixed[k].size() == deepened[k].size());
+        }
+    }
+    SECTION( "an unreachable depth still returns in time, with what it found" ) {
+        auto start = Clock::now();
+        SolutionMap map = find_combos_until(b, start + std::chrono::milliseconds(200), 40);
+        auto elapsed = Clock::now() - start;
+        REQUIRE(elapsed < std::chrono::seconds(2));
+        // How far it got depends on the machine, but whatever it kept has to be right.
+        REQUIRE(map.size() == size_t(consts::MAX_COMBOS + 1));
+        check_replays(b, map);
+    }
+    SECTION( "a deadline in the past gives an empty map" ) {
+        SolutionMap map = find_combos_until(b, Clock::now() - std::chrono::seconds(1), 40);
+        for(const auto& sol : map) {
+            REQUIRE(sol.size() == 0);
+        }
+    }
+}
+
+TEST_CASE( "splitting into subtree tasks does not change solution lengths.", "[dfs][split]" ) {
+    // http://pad.dawnglare.com/?s=DnAuYk0
+    static const std::string COMPLICATED_BOARD =
+        "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+    using namespace dfs;
+    Board b = initialize(COMPLICATED_BOARD);
+    SearchOptions opts;
+    opts.max_depth = 9;
+    opts.split_depth = 1;
+    SolutionMap reference = find_combos(b, opts);
+    for(int split_depth : { 2, 4, 9, 12 }) {
+        opts.split_depth = split_depth;
+        SolutionMap map = find_combos(b, opts);
+        for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
+            REQUIRE(map[k].size() == reference[k].size());
+        }
+    }
+    REQUIRE(choose_split_depth(30, 64, 15) > choose_split_depth(30, 1, 15));
+    REQUIRE(choose_split_depth(30, 64, 2) == 2);
+}
+
+TEST_CASE( "branch and bound keeps the best solution.", "[dfs][bound]" ) {
+    using namespace dfs;
+    for(const std::string& s : { std::string("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR"), std::string("HLHBLGGHGRRDRHBGLDDRGRHRLRLRDL"),
+                                 std::string("brbbrrrgrggrglgllgldlddldhdhhd") }) {
+        Board b = initialize(s);
+        SolutionMap full = find_combos(b, 10);
+        SearchOptions opts;
+        opts.max_depth = 10;
+        opts.bound = true;
+        SolutionMap bounded = find_combos(b, opts);
+        int best = full.size() - 1;
+        while(full[best].size() == 0)
+            best--;
+        REQUIRE(bounded[best].size() == full[best].size());
+        for(size_t k = best + 1; k < bounded.size(); k++) {
+            REQUIRE(bounded[k].size() == 0);
+        }
+    }
+    SECTION( "a board that cannot clear anything has no first wave" ) {
+        Board b = initialize("RGBLDHGBLDHRBLDHRGLDHRGBDHRGBL");
+        auto s = make_search_state(b, {0, 0});
+        REQUIRE(first_wave_bound(s, 1) == 0);
+        REQUIRE(heuristic_bound(s, 1, max_combos_possible(b)) == 0);
+        REQUIRE(first_wave_bound(s, MAX_DEPTH) > 0);
+    }
+}
+
+TEST_CASE( "a Solver reuses its pool across calls.", "[solver]" ) {
+    // http://pad.dawnglare.com/?s=DnAuYk0
+    static const std::string COMPLICATED_BOARD =
+        "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+    using namespace dfs;
+    Board b = initialize(COMPLICATED_BOARD);
+    SolutionMap reference = find_combos(b, 8);
+    for(AffinityPolicy policy : { AffinityPolicy::none, AffinityPolicy::pinned }) {
+        Solver solver(3, policy);
+        REQUIRE(solver.num_threads() == 3);
+        for(int n = 0; n < 3; n++) {
+            SolutionMap map = solver.find_combos(b, 8);
+            for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
+                REQUIRE(map[k].size() == reference[k].size());
+            }
+        }
+        SolutionMap deepened = solver.find_combos_until(b, Clock::now() + std::chrono::hours(1), 8);
+        REQUIRE(deepened[reference.size() - 1].size() == reference.back().size());
+        SolutionMap beamed = solver.beam_find_combos(b, 10, false, NUM_TO_POPULATE, 100);
+        REQUIRE(beamed[0].size() != 0);
+    }
+}
+
+TEST_CASE( "searching the other board sizes.", "[dfs][beam]" ) {
+    using namespace dfs;
+    SECTION( "4x5" ) {
+        SmallBoard b = initialize<4, 5>(
+            "RRGRB"
+            "BGBHH"
+            "LDLDH"
+            "GBLRD");
+        SolutionMap map = find_combos(b, 6);
+        REQUIRE(map.size() == Dims<4, 5>::MAX_COMBOS + 1);
+        REQUIRE(map[1].size() != 0);
+        check_replays(b, map);
+        check_replays(b, beam::find_combos(b, 10, false, NUM_TO_POPULATE, 200));
+    }
+    SECTION( "6x7" ) {
+        LargeBoard b = initialize<6, 7>(
+            "RRGRBHL"
+            "BGBHHDL"
+            "LDLDHGR"
+            "GBLRDBB"
+            "HHRGLDG"
+            "DLBBGRH");
+        SolutionMap map = find_combos(b, 6);
+        REQUIRE(map.size() == Dims<6, 7>::MAX_COMBOS + 1);
+        REQUIRE(map[1].size() != 0);
+        check_replays(b, map);
+        check_replays(b, beam::find_combos(b, 10, false, NUM_TO_POPULATE, 200));
+    }
+}
+
+TEST_CASE( "a weighted policy keeps the highest value path for every combo count.", "[dfs][weighted]" ) {
+    using namespace dfs;
+    Board b = initialize("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR");
+    WeightedScore w;
+    w.color_weight[detail::enum_value(Orb::red)] = 3;
+    w.tpa_multiplier = 1.5;
+    SolutionMap shortest = find_combos(b, 7);
+    SearchOptions opts;
+    opts.max_depth = 7;
+    SolutionMap weighted = find_combos(b, opts, w);
+    check_replays(b, weighted);
+    auto value_of = [&](const Solution& sol) {
+        auto s = make_search_state(b, sol.get_origin());
+        for(const Action& a : sol.get_all_action())
+            apply_move(s, a);
+        int combos;
+        return w.evaluate(s.bits, combos);
+    };
+    for(size_t k = 1; k < weighted.size(); k++) {
+        // The plain search stops early, so it can miss some counts, but never one we have.
+        if(shortest[k].size() == 0)
+            continue;
+        REQUIRE(weighted[k].size() != 0);
+        REQUIRE(weighted[k].get_value() == Approx(value_of(weighted[k])));
+        ScoreDetail report = explain(b, weighted[k]);
+        REQUIRE(report.size() == int(k));
+        REQUIRE(w.value(report) == Approx(weighted[k].get_value()));
+        REQUIRE(weighted[k].get_value() >= value_of(shortest[k]) - 1e-9);
+        // The plain search files the combo count as the value.
+        REQUIRE(shortest[k].get_value() == k);
+    }
+}
+
+TEST_CASE( "a cancelled search stops early.", "[dfs][cancel]" ) {
+    using namespace dfs;
+    Board b = initialize("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR");
+    SECTION( "cancelled before it starts" ) {
+        CancelToken token;
+        token.cancel();
+        SearchOptions opts;
+        opts.max_depth = 10;
+        opts.cancel = &token;
+        SolutionMap map = find_combos(b, opts);
+        for(const Solution& sol : map) {
+            REQUIRE(sol.size() == 0);
+        }
+    }
+    SECTION( "cancelled from another thread" ) {
+        CancelToken token;
+        SearchOptions opts;
+        // Far too deep to ever finish on its own.
+        opts.max_depth = 40;
+        opts.cancel = &token;
+        auto result = std::async(std::launch::async, [&]() {
+            return find_combos(b, opts);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        token.cancel();
+        REQUIRE(result.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+        check_replays(b, result.get());
+    }
+    SECTION( "stopping at the first max_combos path" ) {
+        // Already 6 combos, which is all there is, so a swap within a run gets there in one move.
+        SmallBoard full = initialize<4, 5>(
+            "RRRHH"
+            "GGGHD"
+            "BBBHD"
+            "LLLDD");
+        REQUIRE(max_combos_possible(full) == 6);
+        CancelToken token(true);
+        SearchOptions opts;
+        opts.max_depth = 12;
+        opts.cancel = &token;
+        SolutionMap map = find_combos(full, opts);
+        REQUIRE(token.cancelled());
+        // Whichever path got there first, not necessarily the shortest one.
+        REQUIRE(map[6].size() != 0);
+        check_replays(full, map);
+        REQUIRE(!find_combos_until(full, Clock::time_point::max(), opts)[6].size());
+    }
+}
+
+TEST_CASE( "the incumbent keeps the shortest length for every combo count.", "[dfs][incumbent]" ) {
+    using namespace dfs;
+    Incumbent incumbent(3);
+    REQUIRE(incumbent.improves(0, 20));
+    REQUIRE(!incumbent.covers(20));
+    incumbent.update(2, 5);
+    incumbent.update(1, 7);
+    incumbent.update(2, 6);
+    REQUIRE(incumbent.combos() == 2);
+    REQUIRE(incumbent.length() == 5);
+    REQUIRE(incumbent.shortest_length(2) == 5);
+    REQUIRE(incumbent.shortest_length(3) == Incumbent::NONE);
+    REQUIRE(incumbent.improves(2, 4));
+    REQUIRE(!incumbent.improves(2, 5));
+    incumbent.update(0, 1);
+    incumbent.update(3, 9);
+    // Every count has a path now, the longest of them 9 moves.
+    REQUIRE(incumbent.covers(8));
+    REQUIRE(!incumbent.covers(7));
+    incumbent.update(3, 4);
+    REQUIRE(incumbent.combos() == 3);
+    REQUIRE(incumbent.covers(6));
+
+    SECTION( "from many threads at once" ) {
+        Incumbent shared(consts::MAX_COMBOS);
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; t++) {
+            threads.emplace_back([&shared, t]() {
+                for(int length = 40; length > t; length--) {
+                    for(int k = 0; k <= consts::MAX_COMBOS; k++)
+                        shared.update(k, length + k);
+                }
+            });
+        }
+        for(auto& t : threads)
+            t.join();
+        for(int k = 0; k <= consts::MAX_COMBOS; k++) {
+            REQUIRE(shared.shortest_length(k) == 1 + k);
+        }
+        REQUIRE(shared.covers(consts::MAX_COMBOS));
+        REQUIRE(!shared.covers(consts::MAX_COMBOS - 1));
+    }
+}
+
+TEST_CASE( "search stats add up and don't change the search.", "[dfs][stats]" ) {
+    // http://pad.dawnglare.com/?s=DnAuYk0
+    static const std::string COMPLICATED_BOARD =
+        "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR";
+    using namespace dfs;
+    Board b = initialize(COMPLICATED_BOARD);
+    SolutionMap reference = find_combos(b, 8);
+    SearchStats stats;
+    SearchOptions opts;
+    opts.max_depth = 8;
+    opts.stats = &stats;
+    SolutionMap map = find_combos(b, opts);
+    for(int k = 0; k < consts::MAX_COMBOS + 1; k++) {
+        REQUIRE(map[k].size() == reference[k].size());
+    }
+    REQUIRE(stats.nodes > 0);
+    REQUIRE(stats.scored > 0);
+    REQUIRE(stats.scored < stats.nodes);
+    REQUIRE(stats.pruned_opposite > 0);
+    long thread_nodes = 0;
+    for(long n : stats.thread_nodes)
+        thread_nodes += n;
+    REQUIRE(thread_nodes == stats.nodes);
+    REQUIRE(stats.thread_idle.size() == stats.thread_nodes.size());
+    long simulated = 0;
+    for(long n : stats.cascade_waves)
+        simulated += n;
+    REQUIRE(simulated == stats.scored);
+    // The board has a cascade somewhere.
+    REQUIRE(stats.cascade_waves[2] > 0);
+    REQUIRE(stats.roots.size() == size_t(consts::NUM_ORBS));
+    REQUIRE(stats.root_time.size() == stats.roots.size());
+    REQUIRE(stats.wall.count() > 0);
+    REQUIRE(stats.to_string().find("nodes: ") == 0);
+
+    SECTION( "iterative deepening adds up every depth" ) {
+        SearchStats deepened;
+        opts.stats = &deepened;
+        find_combos_until(b, Clock::now() + std::chrono::hours(1), opts);
+        REQUIRE(deepened.nodes > 0);
+        REQUIRE(deepened.roots.size() == stats.roots.size());
+    }
+}
+
+TEST_CASE( "a solution packs its moves into two words.", "[solution]" ) {
+    Solution sol({2, 3});
+    REQUIRE(sol.size() == 0);
+    std::vector<Action> moves;
+    for(int i = 0; i < Solution::MAX_LENGTH; i++) {
+        Action a = consts::ACTIONS[(i * 7 + i / 3) % 4];
+        sol.push_action(a);
+        moves.push_back(a);
+    }
+    REQUIRE(sol.size() == Solution::MAX_LENGTH);
+    REQUIRE(sol.get_all_action() == moves);
+    REQUIRE_THROWS_AS(sol.push_action(Action::up), std::length_error);
+    REQUIRE(sol.get_all_action() == moves);
+    REQUIRE(sol.get_origin() == Coord {2, 3});
+
+    // Popping back across the word boundary and pushing something else leaves nothing behind.
+    Solution copy = sol;
+    for(int i = 0; i < 40; i++) {
+        REQUIRE(copy.pop_action() == moves.back());
+        moves.pop_back();
+    }
+    for(int i = 0; i < 10; i++) {
+        copy.push_action(Action::up);
+        moves.push_back(Action::up);
+    }
+    REQUIRE(copy.get_all_action() == moves);
+    REQUIRE(sol.size() == Solution::MAX_LENGTH);
+    REQUIRE(copy.to_string().find("(2, 3) : ") == 0);
+
+    // Deeper searches are capped at what a path can hold.
+    Board b = initialize("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR");
+    dfs::SolutionMap map = beam::find_combos(b, 100, false, dfs::NUM_TO_POPULATE, 10);
+    for(const Solution& s : map) {
+        REQUIRE(s.size() <= Solution::MAX_LENGTH);
+    }
+}
+
+TEST_CASE( "a depth out of range searches nothing rather than forever.", "[dfs]" ) {
+    using namespace dfs;
+    Board b = initialize("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR");
+    for(int depth : { -1, -1000, 0 }) {
+        for(const Solution& s : find_combos(b, depth))
+            REQUIRE(s.size() == 0);
+        for(const Solution& s : find_combos_until(b, Clock::now() + std::chrono::hours(1), depth))
+            REQUIRE(s.size() == 0);
+        SolutionMap map = empty_solution_map({0, 0});
+        REQUIRE(dfs_find(b, {0, 0}, max_combos_possible(b), map, depth));
+        for(const Solution& s : map)
+            REQUIRE(s.size() == 0);
+    }
+    REQUIRE(clamp_depth(1000) == Solution::MAX_LENGTH);
+}
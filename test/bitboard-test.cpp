@@ -0,0 +1,72 @@
+#include <iostream>
+#include <random>
+#include "catch.hpp"
+#include "../include/bitboard.hpp"
+
+using namespace pad;
+
+// http://pad.dawnglare.com/?s=VoJBsF0
+static const std::string COMPLICATED_BOARD =
+    "bhhhdhbhdhhhbhlllhddrbbhrrgggb";
+
+TEST_CASE( "Convert between Board and BitBoard.", "[bitboard]" ) {
+    SECTION( "round trip preserves every orb" ) {
+        Board b = initialize(COMPLICATED_BOARD);
+        BitBoard bb = to_bitboard(b);
+        REQUIRE(to_board(bb) == b);
+        REQUIRE(initialize_bitboard(COMPLICATED_BOARD) == bb);
+    }
+    SECTION( "planes partition the board" ) {
+        BitBoard bb = initialize_bitboard(COMPLICATED_BOARD);
+        Mask all = 0;
+        int total = 0;
+        for(Mask p : bb.planes) {
+            REQUIRE((all & p) == 0);
+            all |= p;
+            total += __builtin_popcount(p);
+        }
+        REQUIRE(all == consts::BOARD_MASK);
+        REQUIRE(total == consts::NUM_ORBS);
+    }
+    SECTION( "orb_at agrees with the array board" ) {
+        Board b = initialize(COMPLICATED_BOARD);
+        BitBoard bb = to_bitboard(b);
+        for(int i = 0; i < consts::NUM_ROWS; i++) {
+            for(int j = 0; j < consts::NUM_COLS; j++) {
+                REQUIRE(orb_at(bb, {i, j}) == b[i][j]);
+            }
+        }
+    }
+}
+
+TEST_CASE( "Moves on a BitBoard match moves on a Board.", "[bitboard]" ) {
+    Board b = initialize(COMPLICATED_BOARD);
+    BitBoard bb = to_bitboard(b);
+    for(int i = 0; i < consts::NUM_ROWS; i++) {
+        for(int j = 0; j < consts::NUM_COLS; j++) {
+            auto v = populate(b, {i, j});
+            auto bv = populate(bb, {i, j});
+            REQUIRE(v.size() == bv.size());
+            for(size_t k = 0; k < v.size(); k++) {
+                REQUIRE(v[k].second == bv[k].second);
+                REQUIRE(to_bitboard(v[k].first) == bv[k].first);
+            }
+        }
+    }
+}
+
+TEST_CASE( "Portable pext/pdep agree with the definition.", "[bitboard]" ) {
+    REQUIRE(detail::pext_portable(0b101100, 0b111000) == 0b101);
+    REQUIRE(detail::pdep_portable(0b101, 0b111000) == 0b101000);
+    REQUIRE(detail::pdep_portable(0b11, 0b1010) == 0b1010);
+    std::mt19937 gen(42);
+    for(int n = 0; n < 10000; n++) {
+        Mask src = gen();
+        Mask mask = gen();
+        Mask packed = detail::pext_portable(src, mask);
+        REQUIRE(detail::popcount(packed) == detail::popcount(src & mask));
+        REQUIRE(detail::pdep_portable(packed, mask) == (src & mask));
+        REQUIRE(detail::pext(src, mask) == packed);
+        REQUIRE(detail::pdep(src, mask) == detail::pdep_portable(src, mask));
+    }
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <string>
+#include "catch.hpp"
+#include "../include/request.hpp"
+
+using namespace pad;
+
+TEST_CASE( "request lines override the defaults.", "[request]" ) {
+    request::Request defaults;
+    defaults.depth = 7;
+    request::Request req = defaults;
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=12 deadline_ms=50 json", req) == "");
+    REQUIRE(req.board == "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR");
+    REQUIRE(req.depth == 12);
+    REQUIRE(req.deadline_ms == 50);
+    REQUIRE(req.json);
+    REQUIRE(req.algorithm == request::Algorithm::dfs);
+
+    req = defaults;
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR algorithm=beam width=100", req) == "");
+    REQUIRE(req.depth == 7);
+    REQUIRE(req.algorithm == request::Algorithm::beam);
+    REQUIRE(req.beam_width == 100);
+
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=x", req) != "");
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR color=red", req) != "");
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR algorithm=astar", req) != "");
+
+    // Out of range rather than narrowed to something else.
+    req = defaults;
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=4294967295", req) != "");
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=65", req) != "");
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=-1", req) != "");
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR width=4294967296", req) != "");
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR deadline_ms=9223372036854775807", req) != "");
+    REQUIRE(req.depth == 7);
+    REQUIRE(request::parse("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=64", req) == "");
+    REQUIRE(req.depth == 64);
+}
+
+TEST_CASE( "a server's limits hold for every request.", "[request]" ) {
+    Solver solver(1);
+    request::Request defaults;
+    request::Limits limits;
+    limits.max_depth = 8;
+    limits.max_deadline_ms = 20;
+    REQUIRE(request::answer(solver, "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=9", defaults, limits)
+            == "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR error depth above this server's maximum of 8");
+    // The deepest search there is, but it has to be done by the maximum deadline.
+    limits.max_depth = Solution::MAX_LENGTH;
+    auto start = dfs::Clock::now();
+    std::string answer = request::answer(solver, "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR depth=64", defaults, limits);
+    REQUIRE(dfs::Clock::now() - start < std::chrono::seconds(5));
+    REQUIRE(answer.find(" error ") == std::string::npos);
+
+    // Beam search too: a wider beam than the server allows is an error, and a deep one within it stops
+    // by the deadline (give or take the one depth it checks it at).
+    limits.max_beam_width = 20000;
+    REQUIRE(request::answer(solver, "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR algorithm=beam width=1000000 depth=15", defaults, limits)
+            == "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR error width above this server's maximum of 20000");
+    start = dfs::Clock::now();
+    answer = request::answer(solver, "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR algorithm=beam width=20000 depth=64 deadline_ms=10", defaults, limits);
+    REQUIRE(dfs::Clock::now() - start < std::chrono::seconds(5));
+    REQUIRE(answer.find(" error ") == std::string::npos);
+}
+
+TEST_CASE( "every request gets one answer line.", "[request]" ) {
+    Solver solver(1);
+    request::Request defaults;
+    defaults.depth = 8;
+    // The same path find_combos gives, as "board combos row,col path".
+    std::string answer = request::answer(solver, "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR", defaults);
+    dfs::SolutionMap map = dfs::find_combos(initialize("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR"), 8);
+    int best = map.size() - 1;
+    while(map[best].size() == 0)
+        best--;
+    REQUIRE(answer.find("HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR " + std::to_string(best) + " ") == 0);
+    REQUIRE(answer.size() == 30 + 1 + std::to_string(best).size() + 1 + 3 + 1 + map[best].size());
+
+    // The other board sizes go by the length of the board.
+    REQUIRE(request::answer(solver, "RRGRBBGBHHRRGRBBGBHH", defaults).find(" error ") == std::string::npos);
+    REQUIRE(request::answer(solver, "xyz", defaults) == "xyz error expected 20, 30 or 42 orbs, got 3");
+    REQUIRE(request::answer(solver, "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBq", defaults).find(" error unknown orb") != std::string::npos);
+
+    std::string json = request::answer(solver, "HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR json deadline_ms=20", defaults);
+    REQUIRE(json.find("{\"board\":\"HRHGGHRDGHLBLRRGHHDRBGDRRHRDBR\",\"combos\":") == 0);
+    REQUIRE(json.find("\"solutions\":[{\"combos\":") != std::string::npos);
+    REQUIRE(json.back() == '}');
+    REQUIRE(request::answer(solver, "xyz json", defaults) == "{\"board\":\"xyz\",\"error\":\"expected 20, 30 or 42 orbs, got 3\"}");
+}
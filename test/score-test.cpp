@@ -1,6 +1,11 @@
 #include <iostream>
+#include <algorithm>
+#include <random>
 #include "catch.hpp"
 #include "../include/score.hpp"
+#include "../include/score_batch.hpp"
+#include "../include/scoring.hpp"
+#include "../include/score_detail.hpp"
 #include "../include/display.hpp"
 
 using namespace pad;
@@ -118,3 +123,315 @@ TEST_CASE( "Get total combo of boards", "[score]") {
         REQUIRE(score(b) == 8);
     }
 }
+
+// The original array-based simulation, kept here as the reference the bitboard kernel must agree with.
+template <std::size_t Rows, std::size_t Cols>
+static int reference_score(BoardT<Rows, Cols>& b) {
+    int total = 0;
+    int combo;
+    do {
+        auto mask = detail::init_mask<Rows, Cols>();
+        for(int i = 0; i < int(Rows); i++) {
+            for(int j = 0; j < int(Cols); j++) {
+                remove_match(b, mask, Coord {i, j});
+            }
+        }
+        combo = clear_combos(b, mask);
+        total += combo;
+        skyfall(b);
+    } while(combo);
+    return total;
+}
+
+static std::string random_board(std::mt19937& gen, int num_orbs = consts::NUM_ORBS) {
+    static const std::string ORBS = "ldrbgh";
+    std::uniform_int_distribution<int> dist(0, ORBS.size() - 1);
+    std::string s;
+    for(int i = 0; i < num_orbs; i++)
+        s.push_back(ORBS[dist(gen)]);
+    return s;
+}
+
+TEST_CASE( "Bitboard match detection agrees with remove_match", "[score][bitboard]") {
+    SECTION( "matched cells of the complicated board" ) {
+        Board b = initialize(COMPLICATED_BOARD);
+        ComboMask mask = detail::init_mask();
+        for(int i = 0; i < consts::NUM_ROWS; i++) {
+            for(int j = 0; j < consts::NUM_COLS; j++) {
+                remove_match(b, mask, Coord {i, j});
+            }
+        }
+        BitBoard bb = to_bitboard(b);
+        Mask expected = 0;
+        for(int i = 0; i < consts::NUM_ROWS; i++) {
+            for(int j = 0; j < consts::NUM_COLS; j++) {
+                if(mask[i][j])
+                    expected |= detail::cell_bit(i, j);
+            }
+        }
+        Mask matched = 0;
+        for(int k = 0; k < consts::NUM_PLANES - 1; k++)
+            matched |= detail::match_mask(bb.planes[k]);
+        REQUIRE(matched == expected);
+        REQUIRE(clear_matches(bb) == 4);
+        REQUIRE(bb[Orb::empty] == expected);
+    }
+    SECTION( "total combos on the test boards" ) {
+        for(const std::string& s : { COMPLICATED_BOARD, std::string("BHLHHDBHDHHHBHLLLHDDRBBHRRGGGB") }) {
+            Board b = initialize(s);
+            BitBoard bb = to_bitboard(b);
+            REQUIRE(score(bb) == reference_score(b));
+        }
+    }
+    SECTION( "total combos and final board on random boards" ) {
+        std::mt19937 gen(1337);
+        for(int n = 0; n < 2000; n++) {
+            Board ref = initialize(random_board(gen));
+            Board b = ref;
+            BitBoard bb = to_bitboard(b);
+            int expected = reference_score(ref);
+            REQUIRE(score(bb) == expected);
+            REQUIRE(score(b) == expected);
+            REQUIRE(b == ref);
+            REQUIRE(to_board(bb) == ref);
+        }
+    }
+}
+
+TEST_CASE( "Bitboard skyfall agrees with the array skyfall", "[score][bitboard]") {
+    std::mt19937 gen(7);
+    std::bernoulli_distribution cleared(0.4);
+    for(int n = 0; n < 2000; n++) {
+        Board b = initialize(random_board(gen));
+        for(auto& row : b) {
+            for(auto& o : row) {
+                if(cleared(gen))
+                    o = Orb::empty;
+            }
+        }
+        BitBoard bb = to_bitboard(b);
+        skyfall(b);
+        skyfall(bb);
+        REQUIRE(to_board(bb) == b);
+    }
+}
+
+template <std::size_t Rows, std::size_t Cols>
+static void check_against_reference(std::mt19937& gen) {
+    for(int n = 0; n < 2000; n++) {
+        auto ref = initialize<Rows, Cols>(random_board(gen, Rows * Cols));
+        auto b = ref;
+        auto bb = to_bitboard(b);
+        int expected = reference_score(ref);
+        REQUIRE(score(bb) == expected);
+        REQUIRE(score(b) == expected);
+        REQUIRE(b == ref);
+        REQUIRE(to_board(bb) == ref);
+    }
+}
+
+TEST_CASE( "Bitboard scoring works on the other board sizes", "[score][bitboard]") {
+    std::mt19937 gen(42);
+    SECTION( "4x5 boards" ) {
+        REQUIRE(sizeof(BitBoardT<4, 5>::Mask) == 4);
+        check_against_reference<4, 5>(gen);
+    }
+    SECTION( "6x7 boards, which need 64-bit planes" ) {
+        REQUIRE(sizeof(BitBoardT<6, 7>::Mask) == 8);
+        check_against_reference<6, 7>(gen);
+        // A vertical run in the last column and a horizontal run on the top row, both above bit 32.
+        LargeBoard b = initialize<6, 7>(
+            "rrrbgdh"
+            "lhdgbll"
+            "hdgbldh"
+            "dgbldhl"
+            "gbldhgl"
+            "bldhgbl");
+        REQUIRE(score(b) == 2);
+    }
+}
+
+template <std::size_t Rows, std::size_t Cols>
+static void check_batch(std::mt19937& gen, std::size_t n) {
+    std::vector<BoardT<Rows, Cols>> boards;
+    std::vector<int> expected;
+    for(std::size_t i = 0; i < n; i++) {
+        // Fewer colors make for longer cascades.
+        std::string s = random_board(gen, Rows * Cols);
+        if(i % 2)
+            std::replace(s.begin(), s.end(), 'h', 'l');
+        boards.push_back(initialize<Rows, Cols>(s));
+        auto b = boards.back();
+        expected.push_back(score(b));
+    }
+    std::vector<int> out(n, -1);
+    score_batch(boards.data(), out.data(), n);
+    REQUIRE(out == expected);
+}
+
+TEST_CASE( "Batch scoring agrees with score", "[score][batch]") {
+    std::mt19937 gen(99);
+    // Sizes that are not a multiple of the number of lanes leave some lanes unused.
+    for(std::size_t n : { 0, 1, 7, 33, 2000 }) {
+        check_batch<5, 6>(gen, n);
+        check_batch<4, 5>(gen, n);
+        check_batch<6, 7>(gen, n);
+    }
+    SECTION( "boards that already have empties only fall once they clear something" ) {
+        Board b = initialize("ebbbdheeeeeeeeeeeeeeeeeeeeeeee");
+        Board c = initialize("rebbbhrddhgldrhgldhhgldrhgldrh");
+        Board boards[] = { b, c };
+        int out[2];
+        score_batch(boards, out, 2);
+        REQUIRE(out[0] == score(b));
+        REQUIRE(out[1] == score(c));
+    }
+}
+
+template <std::size_t Rows = consts::NUM_ROWS, std::size_t Cols = consts::NUM_COLS>
+static MaskT<Rows, Cols> cells(std::initializer_list<Coord> coords) {
+    MaskT<Rows, Cols> m = 0;
+    for(const Coord& c : coords)
+        m |= detail::cell_bit<Rows, Cols>(c);
+    return m;
+}
+
+TEST_CASE( "Classify combo shapes", "[score][shape]") {
+    REQUIRE(shape_of<5, 6>(cells({{0, 0}, {0, 1}, {0, 2}})) == Shape::plain);
+    REQUIRE(shape_of<5, 6>(cells({{1, 0}, {1, 1}, {1, 2}, {1, 3}, {1, 4}, {1, 5}})) == Shape::row);
+    REQUIRE(shape_of<5, 6>(cells({{0, 3}, {1, 3}, {2, 3}, {3, 3}})) == Shape::tpa);
+    REQUIRE(shape_of<5, 6>(cells({{4, 1}, {4, 2}, {4, 3}, {4, 4}})) == Shape::tpa);
+    REQUIRE(shape_of<5, 6>(cells({{0, 0}, {0, 1}, {0, 2}, {1, 0}})) == Shape::plain);
+    REQUIRE(shape_of<5, 6>(cells({{2, 2}, {1, 2}, {3, 2}, {2, 1}, {2, 3}})) == Shape::cross);
+    REQUIRE(shape_of<5, 6>(cells({{0, 0}, {1, 0}, {2, 0}, {2, 1}, {2, 2}})) == Shape::l_shape);
+    REQUIRE(shape_of<5, 6>(cells({{2, 5}, {3, 5}, {4, 5}, {2, 4}, {2, 3}})) == Shape::l_shape);
+    // A T is neither.
+    REQUIRE(shape_of<5, 6>(cells({{0, 0}, {0, 1}, {0, 2}, {1, 1}, {2, 1}})) == Shape::plain);
+    REQUIRE(shape_of<5, 6>(cells({{3, 0}, {3, 1}, {3, 2}, {3, 3}, {3, 4}})) == Shape::plain);
+    // A vertical 4 wrapping into the next column is not a line.
+    REQUIRE(shape_of<5, 6>(cells({{3, 0}, {4, 0}, {0, 1}, {1, 1}})) == Shape::plain);
+    // The 4x5 row is 5 long.
+    REQUIRE(shape_of<4, 5>(cells<4, 5>({{0, 0}, {0, 1}, {0, 2}, {0, 3}, {0, 4}})) == Shape::row);
+}
+
+TEST_CASE( "The score visitor sees every combo", "[score][shape]") {
+    std::mt19937 gen(7);
+    for(int n = 0; n < 1000; n++) {
+        BitBoard bb = initialize_bitboard(random_board(gen)), copy = bb;
+        int first_wave = clear_matches(copy);
+        int combos = 0, waves = 0, zeroes = 0;
+        int s = score(bb, [&](const Combo& c) {
+            REQUIRE(c.count >= consts::MIN_ORB_COMBO);
+            REQUIRE(c.wave >= waves);
+            waves = c.wave;
+            zeroes += c.wave == 0;
+            combos++;
+        });
+        REQUIRE(s == combos);
+        REQUIRE(zeroes == first_wave);
+    }
+}
+
+TEST_CASE( "Weighted scoring", "[score][shape]") {
+    // One red row and nothing else.
+    static const std::string ROW_BOARD =
+        "RRRRRR"
+        "BGLDHB"
+        "GLDHBG"
+        "LDHBGL"
+        "DHBGLD";
+    WeightedScore w;
+    int combos;
+    BitBoard bb = initialize_bitboard(ROW_BOARD);
+    // 3 extra orbs, 25% each.
+    REQUIRE(w.evaluate(bb, combos) == Approx(1.75));
+    REQUIRE(combos == 1);
+
+    w.color_weight[detail::enum_value(Orb::red)] = 2;
+    w.row_bonus = 0.1;
+    bb = initialize_bitboard(ROW_BOARD);
+    REQUIRE(w.evaluate(bb, combos) == Approx(2 * 1.75 * 1.1));
+
+    w.color_weight[detail::enum_value(Orb::red)] = 0;
+    bb = initialize_bitboard(ROW_BOARD);
+    REQUIRE(w.evaluate(bb, combos) == 0);
+    REQUIRE(combos == 1);
+
+    SECTION( "combos multiply each other" ) {
+        BitBoard bb = initialize_bitboard(COMPLICATED_BOARD);
+        WeightedScore flat;
+        flat.extra_orb_bonus = 0;
+        REQUIRE(flat.evaluate(bb, combos) == Approx(7 * (1 + 0.25 * 6)));
+        REQUIRE(combos == 7);
+    }
+}
+
+template <std::size_t Rows, std::size_t Cols>
+static void check_detail(std::mt19937& gen) {
+    ScoreDetailT<Rows, Cols> report;
+    for(int n = 0; n < 1000; n++) {
+        auto b = initialize<Rows, Cols>(random_board(gen, Dims<Rows, Cols>::NUM_ORBS));
+        auto bb = to_bitboard(b);
+        int s = score(bb, report);
+        REQUIRE(report.size() == s);
+        REQUIRE(s == reference_score(b));
+        int cleared = 0;
+        for(const Combo& c : report)
+            cleared += c.count;
+        REQUIRE(cleared == detail::popcount(bb[Orb::empty]));
+    }
+}
+
+TEST_CASE( "Score detail lists every combo", "[score][shape]") {
+    ScoreDetail report;
+    Board b = initialize(
+        "RRRRRR"
+        "BGLDHB"
+        "GLDHBG"
+        "LDHBGL"
+        "DHBGLD");
+    REQUIRE(score(b, report) == 1);
+    REQUIRE(report.size() == 1);
+    REQUIRE(report.waves() == 1);
+    REQUIRE(report[0].orb == Orb::red);
+    REQUIRE(report[0].count == 6);
+    REQUIRE(report[0].shape == Shape::row);
+    REQUIRE(report.to_string() == "wave 0: 6 r (row)\n");
+
+    b = initialize(COMPLICATED_BOARD);
+    REQUIRE(score(b, report) == 7);
+    REQUIRE(report.size() == 7);
+    REQUIRE(report.waves() > 1);
+
+    std::mt19937 gen(11);
+    check_detail<4, 5>(gen);
+    check_detail<5, 6>(gen);
+    check_detail<6, 7>(gen);
+}
+
+// A plain scan for runs, to check the tables against.
+static unsigned scan_matches(unsigned pattern, int length) {
+    unsigned matched = 0;
+    for(int i = 0; i < length; i++) {
+        int run = 0;
+        while(i + run < length && ((pattern >> (i + run)) & 1))
+            run++;
+        if(run >= consts::MIN_ORB_COMBO)
+            matched |= ((1u << run) - 1) << i;
+        i += run;
+    }
+    return matched;
+}
+
+TEST_CASE( "Match tables agree with a scan", "[score][table]") {
+    static_assert(MatchTable<5, 6>::ROW[0b111000] == 0b111000, "run at the end of a row");
+    static_assert(MatchTable<5, 6>::COLUMN[0b11011] == 0, "two runs of 2 are no match");
+    for(unsigned p = 0; p < (1u << 4); p++)
+        REQUIRE(MatchTable<4, 5>::COLUMN[p] == scan_matches(p, 4));
+    for(unsigned p = 0; p < (1u << 5); p++)
+        REQUIRE(MatchTable<5, 6>::COLUMN[p] == scan_matches(p, 5));
+    for(unsigned p = 0; p < (1u << 6); p++)
+        REQUIRE(MatchTable<5, 6>::ROW[p] == scan_matches(p, 6));
+    for(unsigned p = 0; p < (1u << 7); p++)
+        REQUIRE(MatchTable<6, 7>::ROW[p] == scan_matches(p, 7));
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <array>
+#include <atomic>
+#include "catch.hpp"
+#include "../include/thread_pool.hpp"
+
+TEST_CASE( "enqueue returns the results through futures.", "[thread_pool]" ) {
+    ThreadPool pool(4);
+    REQUIRE(pool.size() == 4);
+    std::vector<std::future<int>> results;
+    for(int i = 0; i < 1000; i++) {
+        results.push_back(pool.enqueue([](int a, int b) { return a * b; }, i, 2));
+    }
+    for(int i = 0; i < 1000; i++) {
+        REQUIRE(results[i].get() == 2 * i);
+    }
+}
+
+TEST_CASE( "exceptions are delivered to the future.", "[thread_pool]" ) {
+    ThreadPool pool(2);
+    auto f = pool.enqueue([]() -> int { throw std::logic_error("boom"); });
+    REQUIRE_THROWS_AS(f.get(), std::logic_error);
+}
+
+TEST_CASE( "more tasks than the queues hold all run, and the destructor drains them.", "[thread_pool]" ) {
+    std::atomic<int> count {0};
+    const int num_tasks = 4 * ThreadPool::QUEUE_CAPACITY * 3;
+    {
+        ThreadPool pool(3);
+        for(int i = 0; i < num_tasks; i++) {
+            pool.post([&count] { count++; });
+        }
+    }
+    REQUIRE(count == num_tasks);
+}
+
+TEST_CASE( "callables bigger than the inline buffer still work.", "[thread_pool]" ) {
+    ThreadPool pool(2);
+    std::array<int, 64> big;
+    for(int i = 0; i < 64; i++)
+        big[i] = i;
+    auto f = pool.enqueue([big] {
+        int sum = 0;
+        for(int x : big)
+            sum += x;
+        return sum;
+    });
+    REQUIRE(f.get() == 64 * 63 / 2);
+}
+
+TEST_CASE( "workers can enqueue more work.", "[thread_pool]" ) {
+    ThreadPool pool(2);
+    std::atomic<int> count {0};
+    std::promise<void> done;
+    auto f = done.get_future();
+    pool.post([&] {
+        for(int i = 0; i < 100; i++) {
+            pool.post([&] {
+                if(++count == 100)
+                    done.set_value();
+            });
+        }
+    });
+    f.wait();
+    REQUIRE(count == 100);
+}